@@ -93,6 +93,13 @@
 
 #define ENDSTOPS_ONLY_FOR_HOMING // If defined the endstops will only be used for homing
 
+// Watch endstops with pin change interrupts instead of polling them on every step. The position is latched
+// at the pin change and confirmed by a second sample in the next stepper interrupt, like the polled endstops.
+// Only endstops on a pin with pin change interrupt (pins 10-13, 50-53 and 62-69) are watched, the others are
+// still polled by the stepper ISR. This is for other pin maps only: the Ultimaker2 endstops are on pins 22, 26
+// and 29 (PA0, PA4, PA7), which have none, and the build stops when it is enabled with no endstop to watch.
+//#define ENDSTOP_INTERRUPTS_FEATURE
+
 
 //// AUTOSET LOCATIONS OF LIMIT SWITCHES
 //// Added by ZetaPhoenix 09-15-2012
@@ -165,6 +172,12 @@
 
 #define MAX_STEP_FREQUENCY 40000 // Max step frequency for Ultimaker (5000 pps / half step)
 
+// Resolution of the stepper timer lookup table above 2kHz: 2^n steps/s per entry (6..8).
+// Smaller values give a more accurate step timing at high speeds, at the cost of a larger table in flash.
+#ifndef SPEED_LOOKUP_FAST_SHIFT
+  #define SPEED_LOOKUP_FAST_SHIFT 8
+#endif
+
 //By default pololu step drivers require an active high signal. However, some high power drivers require an active low signal as step.
 #define INVERT_X_STEP_PIN false
 #define INVERT_Y_STEP_PIN false
@@ -216,6 +229,76 @@
 #define SD_FINISHED_STEPPERRELEASE false  //if sd support and the file is finished: disable steppers?
 #define SD_FINISHED_RELEASECOMMAND "M84" // You might want to keep the z enabled so your bed stays in place.
 
+// The file browser keeps an index of where each file starts in the current folder, so showing the n-th file does
+// not rescan the folder from the first entry. Folders with more files than SDCARD_INDEX_SIZE keep every 2nd, 4th, ...
+// position, which bounds the scan to a few entries. Costs 2 bytes of RAM per entry, 0 disables the index.
+#define SDCARD_INDEX_SIZE 32
+// List the newest files first (folders on top) in folders that fit in the index. Costs 4 more bytes of RAM per entry.
+//#define SDCARD_SORT_NEWEST_FIRST
+// Open files and folders by their long (VFAT) name too, e.g. "M23 Ultimaker robot.gcode", and list the long names
+// with "M20 L". With the index above, the long names in the current folder are hashed so a lookup only reads the
+// entries whose hash matches. Costs 2 more bytes of RAM per index entry.
+#define SDCARD_LONG_NAME_OPEN
+
+// Remember where layers start in the printed file, with the extruder position, feedrate, fan, and temperatures
+// at that point. Recovering a print (or M26 Z) continues from the closest indexed layer below the requested
+// height instead of reading the file from the start. Once the table is full only every 2nd, 4th, ... layer is kept.
+// Costs 14 + 2*EXTRUDERS bytes of RAM per entry, 0 disables the index. Needs to be an even number.
+#define LAYER_INDEX_SIZE 12
+
+// Journal the SD print in EEPROM, so a print interrupted by a power loss or reset can be recovered from the LCD after
+// the restart. At the first extruding move of every layer the file position and head position before that move are
+// recorded, the temperatures and modes only when they have changed. A record is written one byte per main loop pass,
+// once the moves planned before it have been executed. The 20 byte layer records rotate through 23 slots in the last
+// 460 bytes of the EEPROM, so a slot is rewritten every 23 layers: 100000 EEPROM cycles last 2.3 million layers.
+// Height changes below 0.02mm are not a new layer, which also limits spiralized prints. Costs about 210 bytes of RAM.
+#define POWER_LOSS_JOURNAL
+
+// Log every SD print to PRINT_LOG_FILENAME on the card: when each layer starts and how long the previous one took,
+// temperatures every PRINT_LOG_INTERVAL seconds and the reason when the printer is stopped (see print_log.h).
+// Lines are collected in RAM and written as whole 512 byte blocks, only while the planner has enough moves buffered.
+// Costs PRINT_LOG_BUFFER_SIZE + 90 bytes of RAM.
+//#define PRINT_LOG
+#define PRINT_LOG_FILENAME "PRINTLOG.TXT"
+#define PRINT_LOG_BUFFER_SIZE 512
+#define PRINT_LOG_INTERVAL 60
+
+// Limit how often the UltiLCD2 menu is drawn: at most LCD_MAX_FPS frames per second. When the buttons have not been
+// used for LCD_IDLE_REDRAW milliseconds, a frame is only drawn when the menu, a temperature, the print progress or the
+// status message changed, or LCD_IDLE_REDRAW milliseconds after the last one. The saved time goes to the planner.
+#define LCD_RENDER_GOVERNOR
+#define LCD_MAX_FPS 20
+#define LCD_IDLE_REDRAW 500
+
+// Run the tasks of idle() from a table in priority order. While moves are executing, fewer than IDLE_PLANNER_LOW
+// are planned and commands are waiting, the deferrable tasks (LCD, statistics, journal and log) are skipped so the
+// main loop gets back to the planner first. A deferrable task is also skipped when the tasks before it used up
+// IDLE_TASK_BUDGET microseconds, but never for longer than IDLE_TASK_MAX_DEFER milliseconds.
+// M46 reports runs, deferrals, average and longest run time of each task. Costs 84 bytes of RAM.
+#define IDLE_SCHEDULER
+#define IDLE_PLANNER_LOW (BLOCK_BUFFER_SIZE / 4)
+#define IDLE_TASK_BUDGET 1000
+#define IDLE_TASK_MAX_DEFER 100
+
+// Count what slows a print down: main loop period, command buffer depth, time the planner was empty while commands
+// or the SD file were waiting, time spent reading blocks of the printed file, lost serial characters and stepper
+// interrupts that ran past their next step. M47 reports the counters in one line, M47 R resets them.
+// Costs 62 bytes of RAM.
+#define LOOP_TELEMETRY
+
+// Record a timeline of stepper blocks, planned moves, SD reads and heater PWM changes in a ring buffer.
+// M48 sends it as binary and empties it, decodeTrace.py turns the capture into a Chrome/Perfetto trace.
+// The simulator writes the buffer to the file given in SIM_EVENT_TRACE when it exits.
+// TRACE_BUFFER_SIZE is the number of events, a power of 2 up to 128, and costs 6 bytes of RAM each.
+//#define EVENT_TRACE
+#define TRACE_BUFFER_SIZE 64
+
+// Write the EEPROM from its ready interrupt instead of waiting 3.3 ms per byte, so saving settings or statistics
+// during a print does not stop the main loop. Bytes that do not change are not written. EEPROM_QUEUE_SIZE is the
+// number of bytes that can wait, a power of 2 up to 128, and costs 3 bytes of RAM each.
+#define EEPROM_WRITE_QUEUE
+#define EEPROM_QUEUE_SIZE 32
+
 // The hardware watchdog should reset the Microcontroller disabling all outputs, in case the firmware gets stuck and doesn't do temperature regulation.
 #define USE_WATCHDOG
 
@@ -236,6 +319,7 @@
 #if defined(BABYSTEPPING)
   #define BABYSTEP_XY  //not only z, but also XY in the menu. more clutter, more functions
   #define BABYSTEP_INVERT_Z false  //true for inverse movements in Z
+  #define BABYSTEP_MIN_INTERVAL 500  //minimum time between two babysteps of an axis in microseconds (limits the babystep rate to 2kHz)
 
   #ifdef COREXY
     #error BABYSTEPPING not implemented for COREXY yet.
@@ -269,9 +353,25 @@
 #endif // ADVANCE
 
 // Arc interpretation settings:
-#define MM_PER_ARC_SEGMENT 1
+// The segment length of G2/G3 arcs is derived from the allowed chord error (the maximum distance between
+// a segment and the true arc). Segments are made longer at high feedrates, so that every segment takes
+// at least minsegmenttime and the planner buffer does not run dry. The result is limited to the MIN/MAX values.
+#define ARC_TOLERANCE_MM   0.01
+#define MIN_ARC_SEGMENT_MM 0.1
+#define MAX_ARC_SEGMENT_MM 2.0
 #define N_ARC_CORRECTION 25
 
+// G5 cubic Bezier curve support: G5 X Y [Z E F] I J P Q
+// I,J is the first control point relative to the start, P,Q the second control point relative to the end.
+// The curve is flattened one segment at a time while the planner buffer drains. The parameter step
+// is halved or doubled until the chord error is within BEZIER_TOLERANCE_MM.
+#define BEZIER_CURVE_SUPPORT
+#ifdef BEZIER_CURVE_SUPPORT
+  #define BEZIER_TOLERANCE_MM 0.02
+  #define BEZIER_MIN_STEP     0.002
+  #define BEZIER_MAX_STEP     0.1
+#endif
+
 const int8_t dropsegments=5; //everything with less than this number of steps will be ignored as move and joined with the next movement
 
 // If you are using a RAMPS board or cheap E-bay purchased boards that do not detect when an SD card is inserted
@@ -21,6 +21,7 @@
 #include "fastio.h"
 #include "Configuration.h"
 #include "pins.h"
+#include "eeprom_queue.h"
 
 #ifndef AT90USB
 #define  HardwareSerial_h // trick to disable the standard HWserial
@@ -194,6 +195,10 @@ uint8_t commands_queued();
 void cmd_synchronize();
 void clamp_to_software_endstops(float target[3]);
 void set_current_position(uint8_t axis, const float &pos);
+#if defined(SDSUPPORT) && (LAYER_INDEX_SIZE || defined(POWER_LOSS_JOURNAL))
+#define SEEK_LAYER_SUPPORT
+bool seek_layer(float z); //continue the SD print from the journal or the last indexed layer below z
+#endif
 
 #ifdef FAST_PWM_FAN
 void setPwmFrequency(uint8_t pin, int val);
@@ -44,6 +44,11 @@ FORCE_INLINE void store_char(unsigned char c)
     rx_buffer.buffer[rx_buffer.head] = c;
     rx_buffer.head = i;
   }
+#ifdef LOOP_TELEMETRY
+  else if (telemetry.rx_overflows < 0xFFFF) {
+    ++telemetry.rx_overflows;
+  }
+#endif
 }
 
 
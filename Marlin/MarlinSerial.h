@@ -22,6 +22,7 @@
 #ifndef MarlinSerial_h
 #define MarlinSerial_h
 #include "Marlin.h"
+#include "telemetry.h"
 
 #if !defined(SERIAL_PORT)
 #define SERIAL_PORT 0
@@ -123,6 +124,11 @@ class MarlinSerial //: public Stream
           rx_buffer.buffer[rx_buffer.head] = c;
           rx_buffer.head = i;
         }
+#ifdef LOOP_TELEMETRY
+        else if (telemetry.rx_overflows < 0xFFFF) {
+          ++telemetry.rx_overflows;
+        }
+#endif
       }
     }
 
@@ -50,6 +50,13 @@
 #include "UltiLCD2_menu_print.h"
 #include "commandbuffer.h"
 #include "powerbudget.h"
+#include "layerindex.h"
+#include "print_journal.h"
+#include "print_log.h"
+#include "scheduler.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "memory_stats.h"
 
 #if NUM_SERVOS > 0
 #include "Servo.h"
@@ -71,6 +78,7 @@
 // G2  - CW ARC
 // G3  - CCW ARC
 // G4  - Dwell S<seconds> or P<milliseconds>
+// G5  - Cubic Bezier curve X Y I J P Q (requires BEZIER_CURVE_SUPPORT)
 // G10 - retract filament according to settings of M207
 // G11 - retract recover filament according to settings of M208
 // G28 - Home all Axis
@@ -91,19 +99,24 @@
 //Custom M Codes
 // M17  - Enable/Power all stepper motors
 // M18  - Disable all stepper motors; same as M84
-// M20  - List SD card
+// M20  - List SD card, M20 L also lists the long filenames
 // M21  - Init SD card
 // M22  - Release SD card
 // M23  - Select SD file (M23 filename.g)
 // M24  - Start/resume SD print
 // M25  - Pause SD print
-// M26  - Set SD position in bytes (M26 S12345)
+// M26  - Set SD position in bytes (M26 S12345), or to the last indexed layer below a height (M26 Z12.3)
 // M27  - Report SD print status
 // M28  - Start SD write (M28 filename.g)
 // M29  - Stop SD write
 // M30  - Delete file from SD (M30 filename.g)
 // M31  - Output time since last M109 or SD card start to serial
+// M39  - Report SD block cache and SPI statistics, M39 R resets the counters
 // M42  - Change pin status via gcode Use M42 Px Sy to set pin x to value y, when omitting Px the onboard led will be used.
+// M46  - Report run time statistics of the idle tasks, M46 R resets them (requires IDLE_SCHEDULER)
+// M47  - Report main loop and queue telemetry, M47 R resets it (requires LOOP_TELEMETRY)
+// M48  - Send the event trace as binary and empty it (requires EVENT_TRACE)
+// M49  - Report static, heap and free RAM and the lowest free RAM seen since boot
 // M80  - Turn on Power Supply
 // M81  - Turn off Power Supply
 // M82  - Set E codes absolute (default)
@@ -137,6 +150,7 @@
 // M221 S<factor in percent>- set extrude factor override percentage
 // M240 - Trigger a camera to take a photograph
 // M280 - set servo position absolute. P: servo index, S: angle or microseconds
+// M290 - Babystepping X<mm> Y<mm> Z<mm>, without parameters report the pending babysteps (requires BABYSTEPPING)
 // M300 - Play beepsound S<frequency Hz> P<duration ms>
 // M301 - Set PID parameters P I and D
 // M302 - Allow cold extrudes, or set the minimum extrude S<temperature>.
@@ -242,6 +256,9 @@ uint16_t serialCmd = 0;
 #else
 uint8_t serialCmd = 0;
 #endif // BUFSIZE
+#ifdef SEEK_LAYER_SUPPORT
+static uint32_t cmdfilepos[BUFSIZE]; //file position of the queued commands read from SD, 0 for other commands
+#endif
 static uint8_t serial_count = 0;
 static boolean comment_mode = false;
 static char *strchr_pointer = 0; // just a pointer to find chars in the cmd string like X, Y, Z, E, etc
@@ -273,12 +290,26 @@ static uint8_t Stopped = 0x0;
 //=============================ROUTINES=============================
 //===========================================================================
 static void manage_inactivity();
+static void idle_tasks_run(bool hungry);
 static void get_coordinates(const char *cmd);
 static void get_arc_coordinates(const char *cmd);
 static bool setTargetedHotend(const char *cmd, int code);
 static void prepare_arc_move(char isclockwise);
+#ifdef BEZIER_CURVE_SUPPORT
+static void prepare_bezier_move(const char *cmd);
+#endif
 static void prepare_move(const char *cmd);
 static void get_command();
+#if defined(SDSUPPORT) && LAYER_INDEX_SIZE
+static void index_layer_change(const char *cmd, uint32_t filepos);
+#endif
+#if defined(SDSUPPORT) && defined(POWER_LOSS_JOURNAL)
+static bool journal_layer_start(const char *cmd, float &z);
+static void journal_snapshot(uint32_t filepos, float z);
+#endif
+#if defined(SDSUPPORT) && defined(PRINT_LOG)
+static void log_layer_change(const char *cmd);
+#endif
 static void FlushSerialRequestResend();
 static void ClearToSend();
 
@@ -286,6 +317,36 @@ static void ClearToSend();
 static void recover_toolchange_retract(uint8_t e, bool bSynchronize);
 #endif
 
+#ifdef IDLE_SCHEDULER
+static const char task_heater[] PROGMEM = "heater";
+static const char task_inactivity[] PROGMEM = "inactivity";
+static const char task_lcd[] PROGMEM = "lcd";
+static const char task_stats[] PROGMEM = "stats";
+#if defined(SDSUPPORT) && defined(POWER_LOSS_JOURNAL)
+static const char task_journal[] PROGMEM = "journal";
+#endif
+#if defined(SDSUPPORT) && defined(PRINT_LOG)
+static const char task_log[] PROGMEM = "log";
+#endif
+
+// tasks of idle() in priority order
+static const idle_task_t idle_tasks[] PROGMEM = {
+  { manage_heater, task_heater, 0, IDLE_TASK_CRITICAL },
+  { manage_inactivity, task_inactivity, 0, IDLE_TASK_CRITICAL },
+  { lcd_update, task_lcd, 0, IDLE_TASK_DEFERRABLE },
+  { lifetime_stats_tick, task_stats, 100, IDLE_TASK_DEFERRABLE },
+#if defined(SDSUPPORT) && defined(POWER_LOSS_JOURNAL)
+  { journal_tick, task_journal, 0, IDLE_TASK_DEFERRABLE },
+#endif
+#if defined(SDSUPPORT) && defined(PRINT_LOG)
+  { print_log_tick, task_log, 0, IDLE_TASK_DEFERRABLE },
+#endif
+};
+#define IDLE_TASK_COUNT (sizeof(idle_tasks) / sizeof(idle_tasks[0]))
+// the scheduler keeps the statistics of IDLE_TASKS_MAX tasks, a larger table does not compile
+typedef char idle_tasks_fit_in_IDLE_TASKS_MAX[(IDLE_TASK_COUNT <= IDLE_TASKS_MAX) ? 1 : -1];
+#endif // IDLE_SCHEDULER
+
 void serial_echopair_P(const char *s_P, float v)
     { serialprintPGM(s_P); SERIAL_ECHO(v); }
 void serial_echopair_P(const char *s_P, double v)
@@ -337,6 +398,9 @@ void set_current_position(uint8_t axis, const float &pos)
 static void commit_command(bool isSerialCmd)
 {
   ++buflen;
+#ifdef SEEK_LAYER_SUPPORT
+  cmdfilepos[bufindw] = 0;
+#endif
   if (isSerialCmd)
   {
     //set serial flag for new command
@@ -398,6 +462,19 @@ static void next_command()
     }
     else
     {
+  #if defined(SDSUPPORT) && LAYER_INDEX_SIZE
+    if (cmdfilepos[bufindr])
+      index_layer_change(cmdbuffer[bufindr], cmdfilepos[bufindr]);
+  #endif
+  #ifdef POWER_LOSS_JOURNAL
+    float layer_z;
+    if (cmdfilepos[bufindr] && journal_layer_start(cmdbuffer[bufindr], layer_z) && journal_due(layer_z))
+      journal_snapshot(cmdfilepos[bufindr], layer_z);
+  #endif
+  #ifdef PRINT_LOG
+    if (card.sdprinting() && !(serialCmd & (1 << bufindr)))
+      log_layer_change(cmdbuffer[bufindr]);
+  #endif
     process_command(cmdbuffer[bufindr], serialCmd & (1 << bufindr));
     }
   #else
@@ -575,6 +652,12 @@ void setup()
 #endif
 
   lifetime_stats_init();
+#if defined(SDSUPPORT) && defined(POWER_LOSS_JOURNAL)
+  journal_init();
+#endif
+#ifdef LOOP_TELEMETRY
+  telemetry_reset();
+#endif
   tp_init();    // Initialize temperature loop
   plan_init();  // Initialize planner;
   filament_sensor_init(); // Initialize filament sensor
@@ -608,6 +691,9 @@ void setup()
 
 void loop()
 {
+#ifdef LOOP_TELEMETRY
+  telemetry_loop(buflen);
+#endif
   if (printing_state == PRINT_STATE_ABORT)
   {
     abortPrint(true);
@@ -627,7 +713,11 @@ void loop()
   }
   // manage heater and inactivity
   checkHitEndstops();
+#ifdef IDLE_SCHEDULER
+  idle_tasks_run(buflen && blocks_queued() && movesplanned() < IDLE_PLANNER_LOW);
+#else
   idle();
+#endif
 }
 
 FORCE_INLINE float code_value()
@@ -763,6 +853,7 @@ inline void get_serial_commands()
             case 1:
             case 2:
             case 3:
+            case 5:
               SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
               LCD_MESSAGEPGM(MSG_STOPPED);
               break;
@@ -823,6 +914,9 @@ inline void get_sdcard_commands()
     uint16_t sd_count = 0;
     char sd_char = '\0';
     static uint32_t endOfLineFilePosition = 0;
+#ifdef SEEK_LAYER_SUPPORT
+    static uint32_t startOfLineFilePosition = 0;
+#endif
 
     bool card_eof = card.eof();
     while (buflen < BUFSIZE && !card_eof)
@@ -875,6 +969,12 @@ inline void get_sdcard_commands()
                 lcd_setstatus(time);
 
                 card.printingHasFinished();
+#ifdef POWER_LOSS_JOURNAL
+                journal_stop();
+#endif
+#ifdef PRINT_LOG
+                print_log_stop();
+#endif
                 card.checkautostart(true);
             }
 
@@ -886,7 +986,13 @@ inline void get_sdcard_commands()
             sd_count = 0; //clear buffer
             endOfLineFilePosition = card.getFilePos();
 
+#ifdef SEEK_LAYER_SUPPORT
+            uint8_t cmdindex = bufindw;
+            if (insertcommand(cmd_line_buffer, false))
+                cmdfilepos[cmdindex] = startOfLineFilePosition;
+#else
             insertcommand(cmd_line_buffer, false);
+#endif
         }
         else if (sd_count < MAX_CMD_SIZE - 1)
         {
@@ -896,6 +1002,10 @@ inline void get_sdcard_commands()
             }
             else if (!comment_mode)
             {
+#ifdef SEEK_LAYER_SUPPORT
+                if (!sd_count)
+                    startOfLineFilePosition = card.getFilePos();
+#endif
                 // add char to line buffer
                 cmd_line_buffer[sd_count++] = sd_char;
             }
@@ -906,6 +1016,125 @@ inline void get_sdcard_commands()
          */
     }
 }
+
+#if defined(SDSUPPORT) && LAYER_INDEX_SIZE
+// called before a command from the SD card is executed, a move up to a new height starts a layer
+static void index_layer_change(const char *cmd, uint32_t filepos)
+{
+    // a recovered print continues with the first extruder and absolute Z
+    if (active_extruder || (axis_relative_state & ((1 << Z_AXIS) | RELATIVE_MODE)))
+        return;
+    if (!code_seen(cmd, 'G') || (code_value_long() > 1) || !code_seen(cmd, 'Z'))
+        return;
+    float z = code_value();
+    if (!layer_index_is_new(z, filepos))
+        return;
+
+    layer_entry_t entry;
+    entry.filepos = filepos;
+    entry.e = current_position[E_AXIS];
+    entry.z = uint16_t(z * 100.0f + 0.5f);
+    entry.feedrate = uint16_t(feedrate + 0.5f);
+    entry.fan = fanSpeed;
+    entry.relative = axis_relative_state;
+    for (uint8_t e=0; e<EXTRUDERS; ++e)
+        entry.temperature[e] = target_temperature[e];
+    layer_index_add(entry);
+}
+#endif
+
+#ifdef POWER_LOSS_JOURNAL
+// true for a move that extrudes, z is the height it extrudes at. The first one at a new height starts a layer,
+// z-hops and travel moves don't extrude and are not taken for layers.
+static bool journal_layer_start(const char *cmd, float &z)
+{
+    if (axis_relative_state & ((1 << Z_AXIS) | RELATIVE_MODE))
+        return false;
+    if (!code_seen(cmd, 'G') || (code_value_long() > 1) || !code_seen(cmd, 'E'))
+        return false;
+    float e = code_value();
+    if (!((axis_relative_state & (1 << E_AXIS)) ? (e > 0.0f) : (e > current_position[E_AXIS])))
+        return false;
+    z = code_seen(cmd, 'Z') ? code_value() : current_position[Z_AXIS];
+    return true;
+}
+
+// called before a command from the SD card is executed, when the journal is due
+static void journal_snapshot(uint32_t filepos, float z)
+{
+    journal_record_t record;
+    record.filepos = filepos;
+    for (uint8_t i=0; i<NUM_AXIS; ++i)
+        record.position[i] = current_position[i];
+    record.feedrate = uint16_t(feedrate + 0.5f);
+    record.fan = fanSpeed;
+    record.relative = axis_relative_state;
+    record.extruder = active_extruder;
+    for (uint8_t e=0; e<EXTRUDERS; ++e)
+        record.temperature[e] = target_temperature[e];
+    record.bed = target_temperature_bed;
+    journal_add(record, z);
+}
+#endif
+
+#ifdef PRINT_LOG
+static void log_layer_change(const char *cmd)
+{
+    if (axis_relative_state & ((1 << Z_AXIS) | RELATIVE_MODE))
+        return;
+    if (code_seen(cmd, 'G') && (code_value_long() <= 1) && code_seen(cmd, 'Z'))
+        print_log_move(code_value());
+}
+#endif
+
+#ifdef SEEK_LAYER_SUPPORT
+bool seek_layer(float z)
+{
+    if (!card.isFileOpen())
+        return false;
+#ifdef POWER_LOSS_JOURNAL
+    journal_record_t record;
+    if (journal_find(z, record))
+    {
+        // continue exactly where the interrupted print was
+        card.setIndex(record.filepos);
+        active_extruder = record.extruder;
+        for (uint8_t i=0; i<NUM_AXIS; ++i)
+            set_current_position(i, record.position[i]);
+        plan_set_position(current_position[X_AXIS], current_position[Y_AXIS], current_position[Z_AXIS], current_position[E_AXIS], active_extruder, true);
+        feedrate = record.feedrate;
+        fanSpeed = record.fan;
+        axis_relative_state = record.relative;
+        for (uint8_t e=0; e<EXTRUDERS; ++e)
+            recover_temperature[e] = record.temperature[e];
+        target_temperature_bed = record.bed;
+        return true;
+    }
+#endif
+#if defined(SDSUPPORT) && LAYER_INDEX_SIZE
+    layer_entry_t entry;
+    if (!layer_index_find(z, entry))
+        return false;
+
+    card.setIndex(entry.filepos);
+    set_current_position(E_AXIS, entry.e);
+    plan_set_e_position(entry.e, active_extruder, true);
+    feedrate = entry.feedrate;
+    fanSpeed = entry.fan;
+    axis_relative_state = entry.relative;
+    for (uint8_t e=0; e<EXTRUDERS; ++e)
+    {
+        if (printing_state != PRINT_STATE_RECOVER)
+            setTargetHotend(entry.temperature[e], e);
+        else if (!recover_temperature[e])
+            recover_temperature[e] = entry.temperature[e];
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+#endif
 #endif //SDSUPPORT
 
 static void get_command()
@@ -1268,6 +1497,16 @@ void process_command(const char *strCmd, bool sendAck)
       serial_action_P(PSTR("resume"));
 
       break;
+      #ifdef BEZIER_CURVE_SUPPORT
+      case 5: // G5 - cubic Bezier curve
+        if(!Stopped) {
+          get_coordinates(strCmd);
+          prepare_bezier_move(strCmd);
+          if (sendAck) ClearToSend();
+          return;
+        }
+        break;
+      #endif
       #ifdef FWRETRACT
       case 10: // G10 retract
       if (printing_state == PRINT_STATE_RECOVER)
@@ -1579,7 +1818,11 @@ void process_command(const char *strCmd, bool sendAck)
       if (printing_state == PRINT_STATE_RECOVER)
         break;
       SERIAL_PROTOCOLLNPGM(MSG_BEGIN_FILE_LIST);
+#ifdef SDCARD_LONG_NAME_OPEN
+      card.ls(code_seen(strCmd, 'L'));
+#else
       card.ls();
+#endif
       SERIAL_PROTOCOLLNPGM(MSG_END_FILE_LIST);
       ClearToSend();
       return;
@@ -1607,6 +1850,12 @@ void process_command(const char *strCmd, bool sendAck)
       if (printing_state == PRINT_STATE_RECOVER)
         break;
       card.startFileprint();
+#ifdef POWER_LOSS_JOURNAL
+      journal_start();
+#endif
+#ifdef PRINT_LOG
+      print_log_start();
+#endif
       starttime=millis();
       stoptime=starttime;
       break;
@@ -1620,6 +1869,15 @@ void process_command(const char *strCmd, bool sendAck)
       if(card.isOk() && code_seen(strCmd, 'S')) {
         card.setIndex(code_value_long());
       }
+    #ifdef SEEK_LAYER_SUPPORT
+      else if(card.isOk() && code_seen(strCmd, 'Z')) {
+        if (!seek_layer(code_value()))
+        {
+          SERIAL_ECHO_START;
+          SERIAL_ECHOLNPGM("No indexed layer below Z");
+        }
+      }
+    #endif
       break;
     case 27: //M27 - Get SD status
       card.getStatus();
@@ -1631,7 +1889,7 @@ void process_command(const char *strCmd, bool sendAck)
         char* npos = strchr(strCmd, 'N');
         strchr_pointer = strchr(npos,' ') + 1;
       }
-      card.openFile(strchr_pointer, false);
+      card.openUploadFile(strchr_pointer);
       break;
     case 29: //M29 - Stop SD write
       //processed in write to file routine above
@@ -1650,11 +1908,22 @@ void process_command(const char *strCmd, bool sendAck)
         card.removeFile(strchr_pointer);
       }
       break;
+    case 39: //M39 - Report SD cache and SPI statistics
+      card.printStats();
+      if (code_seen(strCmd, 'R'))
+        card.resetStats();
+      break;
     case 923: //M923 - Select file and start printing
       strchr_pointer += 5;
       truncate_checksum(strchr_pointer);
       card.openFile(strchr_pointer,true);
       card.startFileprint();
+#ifdef POWER_LOSS_JOURNAL
+      journal_start();
+#endif
+#ifdef PRINT_LOG
+      print_log_start();
+#endif
       starttime=millis();
       stoptime=starttime;
       break;
@@ -1684,6 +1953,28 @@ void process_command(const char *strCmd, bool sendAck)
       autotempShutdown();
       }
       break;
+#ifdef IDLE_SCHEDULER
+    case 46: //M46 - Report idle task statistics
+      scheduler_print_stats(idle_tasks, IDLE_TASK_COUNT);
+      if (code_seen(strCmd, 'R'))
+        scheduler_reset_stats();
+      break;
+#endif
+#ifdef LOOP_TELEMETRY
+    case 47: //M47 - Report main loop and queue telemetry
+      telemetry_print();
+      if (code_seen(strCmd, 'R'))
+        telemetry_reset();
+      break;
+#endif
+#ifdef EVENT_TRACE
+    case 48: //M48 - Send the event trace
+      trace_dump();
+      break;
+#endif
+    case 49: //M49 - Report RAM usage
+      memory_print_stats();
+      break;
     case 42: //M42 -Change pin status via gcode
       if (code_seen(strCmd, 'S'))
       {
@@ -2339,6 +2630,36 @@ void process_command(const char *strCmd, bool sendAck)
     }
     break;
 
+    #if defined(BABYSTEPPING)
+    case 290: // M290 - babystep X<mm> Y<mm> Z<mm>, executed by the stepper interrupt during a move
+    {
+      bool seen = false;
+      for(uint8_t i=X_AXIS; i<=Z_AXIS; ++i)
+      {
+        #ifndef BABYSTEP_XY
+        if (i != Z_AXIS) continue;
+        #endif
+        if(code_seen(strCmd, axis_codes[i]))
+        {
+          babystep_add(i, lround(code_value() * axis_steps_per_unit[i]));
+          seen = true;
+        }
+      }
+      if (!seen)
+      {
+        SERIAL_PROTOCOLPGM(MSG_OK);
+        SERIAL_PROTOCOLPGM(" Babysteps pending X:");
+        SERIAL_PROTOCOL(babystep_pending(X_AXIS));
+        SERIAL_PROTOCOLPGM(" Y:");
+        SERIAL_PROTOCOL(babystep_pending(Y_AXIS));
+        SERIAL_PROTOCOLPGM(" Z:");
+        SERIAL_PROTOCOL(babystep_pending(Z_AXIS));
+        SERIAL_EOL;
+      }
+    }
+    break;
+    #endif // BABYSTEPPING
+
     #if NUM_SERVOS > 0
     case 280: // M280 - set servo position absolute. P: servo index, S: angle or microseconds
       {
@@ -3269,6 +3590,24 @@ void calculate_delta(float cartesian[3])
 }
 #endif
 
+// While a print is recovered the moves are not planned, until the first one that extrudes at the recover height
+// starts the print from there. Returns true when the move is to be planned.
+static bool plan_recover_move(const char *cmd)
+{
+  if (card.sdprinting() && (printing_state == PRINT_STATE_RECOVER) && (destination[Z_AXIS] >= recover_height-0.01f))
+  {
+    if (current_position[E_AXIS] != destination[E_AXIS])
+    {
+      for(uint8_t i=0; i < NUM_AXIS; ++i) {
+          recover_position[i] = current_position[i];
+      }
+      recover_start_print(cmd);
+    }
+    return false;
+  }
+  return (printing_state != PRINT_STATE_RECOVER);
+}
+
 static void prepare_move(const char *cmd)
 {
   clamp_to_software_endstops(destination);
@@ -3307,17 +3646,7 @@ static void prepare_move(const char *cmd)
     }
   }
 #else
-  if (card.sdprinting() && (printing_state == PRINT_STATE_RECOVER) && (destination[Z_AXIS] >= recover_height-0.01f))
-  {
-    if (current_position[E_AXIS] != destination[E_AXIS])
-    {
-      for(uint8_t i=0; i < NUM_AXIS; ++i) {
-          recover_position[i] = current_position[i];
-      }
-      recover_start_print(cmd);
-    }
-  }
-  else if (printing_state != PRINT_STATE_RECOVER)
+  if (plan_recover_move(cmd))
   {
     // Do not use feedmultiply for E or Z only moves
     if( (current_position[X_AXIS] == destination [X_AXIS]) && (current_position[Y_AXIS] == destination [Y_AXIS])) {
@@ -3347,6 +3676,26 @@ static void prepare_arc_move(char isclockwise)
   previous_millis_cmd = millis();
 }
 
+#ifdef BEZIER_CURVE_SUPPORT
+static void prepare_bezier_move(const char *cmd)
+{
+  // control point offsets: I,J relative to the start point, P,Q relative to the end point
+  float bezier_offset[4];
+  bezier_offset[0] = code_seen(cmd, 'I') ? code_value() : 0.0f;
+  bezier_offset[1] = code_seen(cmd, 'J') ? code_value() : 0.0f;
+  bezier_offset[2] = code_seen(cmd, 'P') ? code_value() : 0.0f;
+  bezier_offset[3] = code_seen(cmd, 'Q') ? code_value() : 0.0f;
+
+  // a recovered print can also start with a curve
+  if (plan_recover_move(cmd))
+    mc_bezier(current_position, destination, bezier_offset, feedrate*feedmultiply/60/100.0, active_extruder);
+
+  // As far as the parser is concerned, the position is now == target.
+  memcpy(current_position, destination, sizeof(current_position));
+  previous_millis_cmd = millis();
+}
+#endif // BEZIER_CURVE_SUPPORT
+
 #if defined(CONTROLLERFAN_PIN) && CONTROLLERFAN_PIN > -1
 
 #if defined(FAN_PIN)
@@ -3393,14 +3742,39 @@ void controllerFan()
  * Standard idle routine keeps the machine alive
  */
 void idle()
+{
+    idle_tasks_run(false);
+}
+
+// hungry: the main loop has commands for the planner, which runs low
+static void idle_tasks_run(bool hungry)
 {
     static unsigned long lastSerialCommandTime = 0;
 
+#ifdef LOOP_TELEMETRY
+    // waits for heating or dwelling change the printing state, they do not count as starved
+#ifdef SDSUPPORT
+    telemetry_idle(printing_state == PRINT_STATE_NORMAL && !blocks_queued() && (buflen || card.sdprinting()));
+#else
+    telemetry_idle(printing_state == PRINT_STATE_NORMAL && !blocks_queued() && buflen);
+#endif
+#endif
+
+#ifdef IDLE_SCHEDULER
+    scheduler_run(idle_tasks, IDLE_TASK_COUNT, hungry);
+#else
     manage_heater();
     manage_inactivity();
 
     lcd_update();
     lifetime_stats_tick();
+#if defined(SDSUPPORT) && defined(POWER_LOSS_JOURNAL)
+    journal_tick();
+#endif
+#if defined(SDSUPPORT) && defined(PRINT_LOG)
+    print_log_tick();
+#endif
+#endif // IDLE_SCHEDULER
 
     // detect serial communication
     if (commands_queued() && serialCmd)
@@ -3488,6 +3862,7 @@ void kill()
 {
   cli(); // Stop interrupts
   disable_heater();
+  eeprom_queue_flush();
 
   disable_x();
   disable_y();
@@ -3515,6 +3890,9 @@ void Stop(uint8_t reasonNr)
   if(!Stopped) {
     Stopped = reasonNr;
     Stopped_gcode_LastN = gcode_LastN; // Save last g_code for restart
+#if defined(SDSUPPORT) && defined(PRINT_LOG)
+    print_log_error(reasonNr);
+#endif
     SERIAL_ERROR_START;
     SERIAL_ERRORLNPGM(MSG_ERR_STOPPED);
     LCD_MESSAGEPGM(MSG_STOPPED);
@@ -285,6 +285,7 @@ bool Sd2Card::eraseSingleBlockEnable() {
  */
 bool Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
   errorCode_ = type_ = 0;
+  clearStats();
   chipSelectPin_ = chipSelectPin;
   // 16-bit init start time allows over a minute
   uint16_t t0 = (uint16_t)millis();
@@ -354,7 +355,17 @@ bool Sd2Card::init(uint8_t sckRateID, uint8_t chipSelectPin) {
   chipSelectHigh();
 
 #ifndef SOFTWARE_SPI
+#if SD_ADAPTIVE_SPI_RATE
+  if (!setSckRate(sckRateID)) return false;
+  // start one step slower, the requested rate is used after clean reads
+  maxRate_ = sckRateID;
+  if (spiRate_ < SD_SLOWEST_RATE) spiRate_++;
+  cleanBlocks_ = 0;
+  rateUpBlocks_ = SD_RATE_UP_BLOCKS;
+  return true;
+#else  // SD_ADAPTIVE_SPI_RATE
   return setSckRate(sckRateID);
+#endif  // SD_ADAPTIVE_SPI_RATE
 #else  // SOFTWARE_SPI
   return true;
 #endif  // SOFTWARE_SPI
@@ -388,14 +399,25 @@ bool Sd2Card::readBlock(uint32_t blockNumber, uint8_t* dst) {
     if (retryCnt > 0) goto retry;
     goto fail;
   }
+  stats_.blocks++;
+#if SD_ADAPTIVE_SPI_RATE
+  rateSuccess();
+#endif  // SD_ADAPTIVE_SPI_RATE
   return true;
  retry:
+   stats_.retries++;
+#if SD_ADAPTIVE_SPI_RATE
+   // corrupted data, retry with a slower clock
+   if (errorCode_ == SD_CARD_ERROR_CRC || errorCode_ == SD_CARD_ERROR_READ)
+     rateError();
+#endif  // SD_ADAPTIVE_SPI_RATE
    chipSelectHigh();
    cardCommand(CMD12, 0);//Try sending a stop command, but ignore the result.
    errorCode_ = 0;
    goto retry2;
 
  fail:
+  stats_.failures++;
   chipSelectHigh();
   return false;
 }
@@ -484,6 +506,7 @@ bool Sd2Card::readData(uint8_t* dst, uint16_t count) {
         //MSerial.print(calcCrc, HEX);
         //MSerial.print('\n');
         error(SD_CARD_ERROR_CRC);
+        stats_.crcErrors++;
         goto fail;
     }
 }
@@ -574,6 +597,27 @@ bool Sd2Card::setSckRate(uint8_t sckRateID) {
   spiRate_ = sckRateID;
   return true;
 }
+#if SD_ADAPTIVE_SPI_RATE
+//------------------------------------------------------------------------------
+// lower the SPI clock after a transfer error and require a longer run of
+// clean reads before the faster clock is tried again
+void Sd2Card::rateError() {
+  cleanBlocks_ = 0;
+  if (spiRate_ < SD_SLOWEST_RATE) {
+    spiRate_++;
+    stats_.slowDowns++;
+  }
+  if (rateUpBlocks_ < 0X8000) rateUpBlocks_ <<= 1;
+}
+//------------------------------------------------------------------------------
+// raise the SPI clock after a run of clean reads
+void Sd2Card::rateSuccess() {
+  if (spiRate_ > maxRate_ && ++cleanBlocks_ >= rateUpBlocks_) {
+    spiRate_--;
+    cleanBlocks_ = 0;
+  }
+}
+#endif  // SD_ADAPTIVE_SPI_RATE
 //------------------------------------------------------------------------------
 // wait for card to go not busy
 bool Sd2Card::waitNotBusy(uint16_t timeoutMillis) {
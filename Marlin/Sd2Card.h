@@ -149,6 +149,23 @@ uint8_t const SPI_MISO_PIN = SOFT_SPI_MISO_PIN;
 uint8_t const SPI_SCK_PIN = SOFT_SPI_SCK_PIN;
 #endif  // SOFTWARE_SPI
 //------------------------------------------------------------------------------
+/**
+ * \struct sd_stats_t
+ * \brief Block read statistics of an Sd2Card
+ */
+struct sd_stats_t {
+  /** blocks read successfully */
+  uint32_t blocks;
+  /** blocks received with a CRC error */
+  uint16_t crcErrors;
+  /** reads that were retried */
+  uint16_t retries;
+  /** reads that failed after all retries */
+  uint16_t failures;
+  /** times the SPI clock was lowered */
+  uint16_t slowDowns;
+};
+//------------------------------------------------------------------------------
 /**
  * \class Sd2Card
  * \brief Raw access to SD and SDHC flash memory cards.
@@ -209,6 +226,12 @@ class Sd2Card {
   bool readStart(uint32_t blockNumber);
   bool readStop();
   bool setSckRate(uint8_t sckRateID);
+  /** \return The current SPI clock rate selector. See setSckRate(). */
+  uint8_t sckRate() const {return spiRate_;}
+  /** \return Block read statistics since init() or clearStats(). */
+  const sd_stats_t& stats() const {return stats_;}
+  /** Reset the block read statistics. */
+  void clearStats() {memset(&stats_, 0, sizeof(stats_));}
   /** Return the card type: SD V1, SD V2 or SDHC
    * \return 0 - SD V1, 1 - SD V2, or 3 - SDHC.
    */
@@ -224,6 +247,14 @@ class Sd2Card {
   uint8_t spiRate_;
   uint8_t status_;
   uint8_t type_;
+  sd_stats_t stats_;
+#if SD_ADAPTIVE_SPI_RATE
+  uint8_t maxRate_;         // fastest rate allowed by init()
+  uint16_t cleanBlocks_;    // blocks read without error at the current rate
+  uint16_t rateUpBlocks_;   // clean blocks needed to raise the rate
+  void rateError();
+  void rateSuccess();
+#endif  // SD_ADAPTIVE_SPI_RATE
   // private functions
   uint8_t cardAcmd(uint8_t cmd, uint32_t arg) {
     cardCommand(CMD55, 0);
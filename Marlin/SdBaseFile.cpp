@@ -28,15 +28,27 @@ SdBaseFile* SdBaseFile::cwd_ = 0;
 // callback function for date/time
 void (*SdBaseFile::dateTime_)(uint16_t* date, uint16_t* time) = 0;
 //------------------------------------------------------------------------------
-// add a cluster to a file
-bool SdBaseFile::addCluster() {
-  if (!vol_->allocContiguous(1, &curCluster_)) goto fail;
+// add a cluster to a file, a count above one preallocates a contiguous
+// run that is written as one stream and trimmed again by close()
+bool SdBaseFile::addCluster(uint32_t count) {
+  // use shorter runs if the volume is too fragmented
+  while (!vol_->allocContiguous(count, &curCluster_)) {
+    if (count == 1) goto fail;
+    count >>= 1;
+  }
+  if (count > 1) flags_ |= F_FILE_PREALLOC;
 
   // if first cluster of file link to directory entry
   if (firstCluster_ == 0) {
     firstCluster_ = curCluster_;
     flags_ |= F_FILE_DIR_DIRTY;
   }
+  if (isFile()) {
+    if (!vol_->writeStreamStart(vol_->clusterStartBlock(curCluster_),
+                                count << vol_->clusterSizeShift_)) {
+      goto fail;
+    }
+  }
   return true;
 
  fail:
@@ -56,14 +68,14 @@ bool SdBaseFile::addDirCluster() {
   block = vol_->clusterStartBlock(curCluster_);
 
   // set cache to first block of cluster
-  vol_->cacheSetBlockNumber(block, true);
+  if (!vol_->cacheSetBlockNumber(block, SdVolume::CACHE_META)) goto fail;
 
   // zero first block of cluster
-  memset(vol_->cacheBuffer_.data, 0, 512);
+  memset(vol_->cache()->data, 0, 512);
 
   // zero rest of cluster
   for (uint8_t i = 1; i < vol_->blocksPerCluster_; i++) {
-    if (!vol_->writeBlock(block + i, vol_->cacheBuffer_.data)) goto fail;
+    if (!vol_->writeBlock(block + i, vol_->cache()->data)) goto fail;
   }
   // Increase directory file size by cluster size
   fileSize_ += 512UL << vol_->clusterSizeShift_;
@@ -76,7 +88,7 @@ bool SdBaseFile::addDirCluster() {
 // cache a file's directory entry
 // return pointer to cached entry or null for failure
 dir_t* SdBaseFile::cacheDirEntry(uint8_t action) {
-  if (!vol_->cacheRawBlock(dirBlock_, action)) goto fail;
+  if (!vol_->cacheRawBlock(dirBlock_, action, SdVolume::CACHE_META)) goto fail;
   return vol_->cache()->dir + dirIndex_;
 
  fail:
@@ -91,8 +103,17 @@ dir_t* SdBaseFile::cacheDirEntry(uint8_t action) {
  * Reasons for failure include no file is open or an I/O error.
  */
 bool SdBaseFile::close() {
-  bool rtn = sync();
+  bool rtn = true;
+  // release preallocated clusters
+  if (isFile() && (flags_ & F_FILE_PREALLOC)) {
+    rtn = truncate(fileSize_);
+    flags_ &= ~F_FILE_PREALLOC;
+  }
+  rtn = sync() && rtn;
   type_ = FAT_FILE_TYPE_CLOSED;
+#if SD_EXTENT_MAP_SIZE
+  extents_ = 0;
+#endif
   return rtn;
 }
 //------------------------------------------------------------------------------
@@ -493,8 +514,9 @@ bool SdBaseFile::mkdir(SdBaseFile* parent, const uint8_t dname[11]) {
 
   // cache block for '.'  and '..'
   block = vol_->clusterStartBlock(firstCluster_);
-  if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) goto fail;
-
+  if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE, SdVolume::CACHE_META)) {
+    goto fail;
+  }
   // copy '.' to block
   memcpy(&vol_->cache()->dir[0], &d, sizeof(d));
 
@@ -853,10 +875,10 @@ bool SdBaseFile::openParent(SdBaseFile* dir) {
   // start block for '..'
   lbn = vol_->clusterStartBlock(cluster);
   // first block of parent dir
-  if (!vol_->cacheRawBlock(lbn, SdVolume::CACHE_FOR_READ)) {
+  if (!vol_->cacheRawBlock(lbn, SdVolume::CACHE_FOR_READ, SdVolume::CACHE_META)) {
     goto fail;
   }
-  p = &vol_->cacheBuffer_.dir[1];
+  p = &vol_->cache()->dir[1];
   // verify name for '../..'
   if (p->name[0] != '.' || p->name[1] != '.') goto fail;
   // '..' is pointer to first cluster of parent. open '../..' to find parent
@@ -1068,6 +1090,10 @@ int16_t SdBaseFile::read(void* buf, uint16_t nbyte) {
           // use first cluster in file
           curCluster_ = firstCluster_;
         } else {
+#if SD_EXTENT_MAP_SIZE
+          if (!extents_ || !extents_->lookup(
+                curPosition_ >> (vol_->clusterSizeShift_ + 9), &curCluster_))
+#endif
           // get next cluster from FAT
           if (!vol_->fatGet(curCluster_, &curCluster_)) goto fail;
         }
@@ -1080,11 +1106,13 @@ int16_t SdBaseFile::read(void* buf, uint16_t nbyte) {
     if (n > (512 - offset)) n = 512 - offset;
 
     // no buffering needed if n == 512
-    if (n == 512 && block != vol_->cacheBlockNumber()) {
+    if (n == 512 && !vol_->cacheContains(block)) {
       if (!vol_->readBlock(block, dst)) goto fail;
     } else {
-      // read block to cache and copy data to caller
-      if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) goto fail;
+      // read block to cache and copy data to caller, directories are
+      // cached with the FAT so browsing does not evict file data
+      if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_READ,
+            isDir() ? SdVolume::CACHE_META : SdVolume::CACHE_DATA)) goto fail;
       uint8_t* src = vol_->cache()->data + offset;
       memcpy(dst, src, n);
     }
@@ -1309,7 +1337,9 @@ bool SdBaseFile::rename(SdBaseFile* dirFile, const char* newPath) {
   if (dirCluster) {
     // get new dot dot
     uint32_t block = vol_->clusterStartBlock(dirCluster);
-    if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_READ)) goto fail;
+    if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_READ, SdVolume::CACHE_META)) {
+      goto fail;
+    }
     memcpy(&entry, &vol_->cache()->dir[1], sizeof(entry));
 
     // free unused cluster
@@ -1317,7 +1347,9 @@ bool SdBaseFile::rename(SdBaseFile* dirFile, const char* newPath) {
 
     // store new dot dot
     block = vol_->clusterStartBlock(firstCluster_);
-    if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) goto fail;
+    if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE, SdVolume::CACHE_META)) {
+      goto fail;
+    }
     memcpy(&vol_->cache()->dir[1], &entry, sizeof(entry));
   }
   return vol_->cacheFlush();
@@ -1443,6 +1475,9 @@ bool SdBaseFile::rmRfStar() {
 SdBaseFile::SdBaseFile(const char* path, uint8_t oflag) {
   type_ = FAT_FILE_TYPE_CLOSED;
   writeError = false;
+#if SD_EXTENT_MAP_SIZE
+  extents_ = 0;
+#endif
   open(path, oflag);
 }
 //------------------------------------------------------------------------------
@@ -1473,6 +1508,12 @@ bool SdBaseFile::seekSet(uint32_t pos) {
   nCur = (curPosition_ - 1) >> (vol_->clusterSizeShift_ + 9);
   nNew = (pos - 1) >> (vol_->clusterSizeShift_ + 9);
 
+#if SD_EXTENT_MAP_SIZE
+  if (extents_ && extents_->lookup(nNew, &curCluster_)) {
+    curPosition_ = pos;
+    goto done;
+  }
+#endif
   if (nNew < nCur || curPosition_ == 0) {
     // must follow chain from first cluster
     curCluster_ = firstCluster_;
@@ -1496,6 +1537,89 @@ void SdBaseFile::setpos(sd_fpos_t* pos) {
   curPosition_ = pos->position;
   curCluster_ = pos->cluster;
 }
+#if SD_EXTENT_MAP_SIZE
+//------------------------------------------------------------------------------
+/** Resolve the cluster chain of a read only file into an extent map.
+ *
+ * read() and seekSet() use the map instead of the FAT until the file
+ * is closed. The map must stay valid while the file is open.
+ *
+ * \param[in] map The map to build, or null to detach the current map.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ * Reasons for failure include the file is not a normal file,
+ * the file is open for write or an I/O error occurred.
+ */
+bool SdBaseFile::setExtentMap(SdExtentMap* map) {
+  extents_ = 0;
+  if (!map) return true;
+  if (!isFile() || (flags_ & O_WRITE)) return false;
+  if (!map->build(vol_, firstCluster_)) return false;
+  extents_ = map;
+  return true;
+}
+//------------------------------------------------------------------------------
+/** Follow a cluster chain and store it as runs of contiguous clusters.
+ *
+ * A fully contiguous file results in a single extent. If the chain has
+ * more runs than fit in the map, only the start of the chain is mapped.
+ *
+ * \param[in] vol Volume that contains the chain.
+ * \param[in] cluster First cluster of the chain, zero for an empty file.
+ *
+ * \return The value one, true, is returned for success and
+ * the value zero, false, is returned for failure.
+ */
+bool SdExtentMap::build(SdVolume* vol, uint32_t cluster) {
+  uint32_t index = 0;
+  uint32_t next;
+  count_ = 0;
+  complete_ = true;
+  if (cluster == 0) return true;
+
+  extent_[0].cluster = cluster;
+  while (true) {
+    index++;
+    if (!vol->fatGet(cluster, &next)) goto fail;
+    if (next == (cluster + 1)) {
+      cluster = next;
+      continue;
+    }
+    extent_[count_++].end = index;
+    if (vol->isEOC(next)) return true;
+    if (count_ == SD_EXTENT_MAP_SIZE) {
+      complete_ = false;
+      return true;
+    }
+    extent_[count_].cluster = next;
+    cluster = next;
+  }
+
+ fail:
+  count_ = 0;
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Find the cluster at a position in the chain.
+ *
+ * \param[in] index Cluster index relative to the start of the file.
+ * \param[out] cluster The cluster number if \a index is mapped.
+ *
+ * \return True if \a index is covered by the map else false.
+ */
+bool SdExtentMap::lookup(uint32_t index, uint32_t* cluster) const {
+  uint32_t start = 0;
+  for (uint8_t i = 0; i < count_; i++) {
+    if (index < extent_[i].end) {
+      *cluster = extent_[i].cluster + (index - start);
+      return true;
+    }
+    start = extent_[i].end;
+  }
+  return false;
+}
+#endif  // SD_EXTENT_MAP_SIZE
 //------------------------------------------------------------------------------
 /** The sync() call causes all modified data and directory fields
  * to be written to the storage device.
@@ -1529,7 +1653,7 @@ bool SdBaseFile::sync() {
     // clear directory dirty
     flags_ &= ~F_FILE_DIR_DIRTY;
   }
-  return vol_->cacheFlush();
+  return vol_->cacheFlush() && vol_->writeStreamStop();
 
  fail:
   writeError = true;
@@ -1733,6 +1857,9 @@ int16_t SdBaseFile::write(const void* buf, uint16_t nbyte) {
   // number of bytes left to write  -  must be before goto statements
   uint16_t nToWrite = nbyte;
 
+  // clusters to allocate at end of chain  -  must be before goto statements
+  uint32_t prealloc;
+
   // error if not a normal file or is read-only
   if (!isFile() || !(flags_ & O_WRITE)) goto fail;
 
@@ -1741,6 +1868,13 @@ int16_t SdBaseFile::write(const void* buf, uint16_t nbyte) {
     if (!seekEnd()) goto fail;
   }
 
+  // clusters to allocate when the file grows
+  prealloc = 1;
+  if (flags_ & F_FILE_GROW_RUNS) {
+    prealloc = SD_WRITE_PREALLOC_BLOCKS >> vol_->clusterSizeShift_;
+    if (prealloc == 0) prealloc = 1;
+  }
+
   while (nToWrite > 0) {
     uint8_t blockOfCluster = vol_->blockOfCluster(curPosition_);
     uint16_t blockOffset = curPosition_ & 0X1FF;
@@ -1749,7 +1883,7 @@ int16_t SdBaseFile::write(const void* buf, uint16_t nbyte) {
       if (curCluster_ == 0) {
         if (firstCluster_ == 0) {
           // allocate first cluster of file
-          if (!addCluster()) goto fail;
+          if (!addCluster(prealloc)) goto fail;
         } else {
           curCluster_ = firstCluster_;
         }
@@ -1758,7 +1892,7 @@ int16_t SdBaseFile::write(const void* buf, uint16_t nbyte) {
         if (!vol_->fatGet(curCluster_, &next)) goto fail;
         if (vol_->isEOC(next)) {
           // add cluster if at end of chain
-          if (!addCluster()) goto fail;
+          if (!addCluster(prealloc)) goto fail;
         } else {
           curCluster_ = next;
         }
@@ -1774,20 +1908,18 @@ int16_t SdBaseFile::write(const void* buf, uint16_t nbyte) {
     uint32_t block = vol_->clusterStartBlock(curCluster_) + blockOfCluster;
     if (n == 512) {
       // full block - don't need to use cache
-      if (vol_->cacheBlockNumber() == block) {
-        // invalidate cache if block is in cache
-        vol_->cacheSetBlockNumber(0XFFFFFFFF, false);
-      }
+      // invalidate cache if block is in cache
+      vol_->cacheInvalidate(block);
       if (!vol_->writeBlock(block, src)) goto fail;
     } else {
+      uint8_t kind = isDir() ? SdVolume::CACHE_META : SdVolume::CACHE_DATA;
       if (blockOffset == 0 && curPosition_ >= fileSize_) {
         // start of new block don't need to read into cache
-        if (!vol_->cacheFlush()) goto fail;
         // set cache dirty and SD address of block
-        vol_->cacheSetBlockNumber(block, true);
+        if (!vol_->cacheSetBlockNumber(block, kind)) goto fail;
       } else {
         // rewrite part of block
-        if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE)) goto fail;
+        if (!vol_->cacheRawBlock(block, SdVolume::CACHE_FOR_WRITE, kind)) goto fail;
       }
       uint8_t* dst = vol_->cache()->data + blockOffset;
       memcpy(dst, src, n);
@@ -175,6 +175,32 @@ uint16_t const FAT_DEFAULT_DATE = ((2000 - 1980) << 9) | (1 << 5) | 1;
 /** Default time for file timestamp is 1 am */
 uint16_t const FAT_DEFAULT_TIME = (1 << 11);
 //------------------------------------------------------------------------------
+#if SD_EXTENT_MAP_SIZE
+/**
+ * \class SdExtentMap
+ * \brief Cluster chain of a file stored as runs of contiguous clusters.
+ */
+class SdExtentMap {
+ public:
+  SdExtentMap() : count_(0) {}
+  bool build(SdVolume* vol, uint32_t cluster);
+  bool lookup(uint32_t index, uint32_t* cluster) const;
+  /** \return The number of extents in the map. */
+  uint8_t count() const {return count_;}
+  /** \return True if the map covers the whole cluster chain. */
+  bool complete() const {return complete_;}
+
+ private:
+  struct extent_t {
+    uint32_t cluster;  // first cluster of this run
+    uint32_t end;      // file cluster index following this run
+  };
+  uint8_t  count_;
+  bool     complete_;
+  extent_t extent_[SD_EXTENT_MAP_SIZE];
+};
+#endif  // SD_EXTENT_MAP_SIZE
+//------------------------------------------------------------------------------
 /**
  * \class SdBaseFile
  * \brief Base class for SdFile with Print and C++ streams.
@@ -182,7 +208,11 @@ uint16_t const FAT_DEFAULT_TIME = (1 << 11);
 class SdBaseFile {
  public:
   /** Create an instance. */
+#if SD_EXTENT_MAP_SIZE
+  SdBaseFile() : writeError(false), type_(FAT_FILE_TYPE_CLOSED), extents_(0) {}
+#else
   SdBaseFile() : writeError(false), type_(FAT_FILE_TYPE_CLOSED) {}
+#endif
   SdBaseFile(const char* path, uint8_t oflag);
   ~SdBaseFile() {if(isOpen()) close();}
   /**
@@ -253,6 +283,9 @@ class SdBaseFile {
   uint32_t fileSize() const {return fileSize_;}
   /** \return The first cluster number for a file or directory. */
   uint32_t firstCluster() const {return firstCluster_;}
+#if SD_EXTENT_MAP_SIZE
+  bool setExtentMap(SdExtentMap* map);
+#endif
   bool getFilename(char* name);
   /** \return True if this is a directory else false. */
   bool isDir() const {return type_ >= FAT_FILE_TYPE_MIN_DIR;}
@@ -320,6 +353,11 @@ class SdBaseFile {
   /** \return SdVolume that contains this file. */
   SdVolume* volume() const {return vol_;}
   int16_t write(const void* buf, uint16_t nbyte);
+  /** Grow the file in contiguous runs of SD_WRITE_PREALLOC_BLOCKS until it is
+   * closed. The unused tail of a run is only released by close(), a file that
+   * is never closed keeps it as lost clusters, so only use this for uploads.
+   */
+  void preallocate() {flags_ |= F_FILE_GROW_RUNS;}
 //------------------------------------------------------------------------------
  private:
   // allow SdFat to set cwd_
@@ -331,6 +369,10 @@ class SdBaseFile {
   // bits defined in flags_
   // should be 0X0F
   static uint8_t const F_OFLAG = (O_ACCMODE | O_APPEND | O_SYNC);
+  // grow the file in preallocated runs, see preallocate()
+  static uint8_t const F_FILE_GROW_RUNS = 0X20;
+  // clusters past the end of file are preallocated
+  static uint8_t const F_FILE_PREALLOC = 0X40;
   // sync of directory entry required
   static uint8_t const F_FILE_DIR_DIRTY = 0X80;
 
@@ -345,11 +387,14 @@ class SdBaseFile {
   uint32_t  fileSize_;      // file size in bytes
   uint32_t  firstCluster_;  // first cluster of file
   SdVolume* vol_;           // volume where file is located
+#if SD_EXTENT_MAP_SIZE
+  SdExtentMap* extents_;    // resolved cluster chain, read only files
+#endif
 
   /** experimental don't use */
   bool openParent(SdBaseFile* dir);
   // private functions
-  bool addCluster();
+  bool addCluster(uint32_t count = 1);
   bool addDirCluster();
   dir_t* cacheDirEntry(uint8_t action);
   int8_t lsPrintNext( uint8_t flags, uint8_t indent);
@@ -73,6 +73,20 @@
  */
 #define SPI_SD_INIT_RATE 5
 //------------------------------------------------------------------------------
+/**
+ * Adapt the SPI clock to the error rate of the card if nonzero.
+ *
+ * Reads start one step below the rate passed to Sd2Card::init() and step up
+ * after SD_RATE_UP_BLOCKS blocks were read without error. A CRC or data token
+ * error steps the clock down before the read is retried, and doubles the
+ * number of clean blocks needed to step up again.
+ */
+#define SD_ADAPTIVE_SPI_RATE 1
+/** Blocks read without error before the SPI clock is raised one step */
+#define SD_RATE_UP_BLOCKS 512
+/** Slowest SPI rate used after errors, F_CPU/32 */
+#define SD_SLOWEST_RATE 4
+//------------------------------------------------------------------------------
 /**
  * Set the SS pin high for hardware SPI.  If SS is chip select for another SPI
  * device this will disable that device during the SD init phase.
@@ -103,6 +117,43 @@ uint8_t const SOFT_SPI_MISO_PIN = 12;
 /** Software SPI Clock pin */
 uint8_t const SOFT_SPI_SCK_PIN = 13;
 //------------------------------------------------------------------------------
+/**
+ * Number of 512 byte block cache slots for file data and for file system
+ * metadata (FAT and directory blocks).
+ *
+ * Keeping metadata in its own slots means listing a directory or following
+ * the FAT does not evict the block a print is streaming from. Slots of the
+ * same kind are reused in least recently used order. Each slot costs about
+ * 524 bytes of SRAM. With SD_CACHE_META_SLOTS zero metadata shares the data
+ * slots, like the original single block cache.
+ */
+#define SD_CACHE_DATA_SLOTS 1
+#define SD_CACHE_META_SLOTS 1
+//------------------------------------------------------------------------------
+/**
+ * Number of blocks preallocated as one contiguous run when a file opened
+ * for upload (M28, SdBaseFile::preallocate()) grows.
+ *
+ * The data blocks of the run are sent to the card with a multiple block
+ * write and FAT updates stay in the cache until the run is used up or the
+ * file is synced. Clusters that are not used are released by close(), so
+ * an upload cut off by a power loss or a removed card leaves them lost until
+ * the card is checked. Other files, like the print log that stays open for
+ * the whole print, grow one cluster at a time and still use the multiple
+ * block write within a cluster. Set to zero to allocate one cluster at a time.
+ */
+#define SD_WRITE_PREALLOC_BLOCKS 2048
+//------------------------------------------------------------------------------
+/**
+ * Number of contiguous cluster runs kept in an SdExtentMap.
+ *
+ * The cluster chain of the printed file is resolved when it is opened so
+ * that reading and seeking need no FAT lookups. Each extent costs 8 bytes
+ * of SRAM. Clusters past the last mapped extent are followed through the
+ * FAT as before. Set to zero to disable the extent map.
+ */
+#define SD_EXTENT_MAP_SIZE 8
+//------------------------------------------------------------------------------
 /**
  * The __cxa_pure_virtual function is an error handler that is invoked when
  * a pure virtual function is called.
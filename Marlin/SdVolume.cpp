@@ -24,11 +24,15 @@
 //------------------------------------------------------------------------------
 #if !USE_MULTIPLE_CARDS
 // raw block cache
-uint32_t SdVolume::cacheBlockNumber_;  // current block number
-cache_t  SdVolume::cacheBuffer_;       // 512 byte cache for Sd2Card
+cache_slot_t  SdVolume::cacheSlot_[SD_CACHE_SLOTS];  // 512 byte caches for Sd2Card
+cache_slot_t* SdVolume::cacheCur_ = SdVolume::cacheSlot_;  // slot of the last cached block
+uint16_t SdVolume::cacheTick_;         // access counter for LRU eviction
+uint32_t SdVolume::cacheHits_[2];      // lookups served from cache
+uint32_t SdVolume::cacheMisses_[2];    // lookups that read the card
 Sd2Card* SdVolume::sdCard_;            // pointer to SD card object
-bool     SdVolume::cacheDirty_;        // cacheFlush() will write block if true
-uint32_t SdVolume::cacheMirrorBlock_;  // mirror  block for second FAT
+uint32_t SdVolume::writeStreamBlock_ = 0XFFFFFFFF;  // next block of the write stream
+uint32_t SdVolume::writeStreamEnd_;    // first block past the write stream
+bool     SdVolume::writeStreamOpen_;   // card is in a multiple block write
 #endif  // USE_MULTIPLE_CARDS
 //------------------------------------------------------------------------------
 // find a contiguous group of clusters
@@ -105,18 +109,64 @@ bool SdVolume::allocContiguous(uint32_t count, uint32_t* curCluster) {
 }
 //------------------------------------------------------------------------------
 bool SdVolume::cacheFlush() {
-  if (cacheDirty_) {
-    if (!sdCard_->writeBlock(cacheBlockNumber_, cacheBuffer_.data)) {
+  for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+    if (!cacheWriteBack(&cacheSlot_[i])) return false;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+// return the slot holding a block or null if the block is not cached
+cache_slot_t* SdVolume::cacheFind(uint32_t blockNumber) {
+  for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+    if (cacheSlot_[i].block == blockNumber) return &cacheSlot_[i];
+  }
+  return 0;
+}
+//------------------------------------------------------------------------------
+// drop a block from the cache without writing it
+void SdVolume::cacheInvalidate(uint32_t blockNumber) {
+  cache_slot_t* slot = cacheFind(blockNumber);
+  if (slot) {
+    slot->block = 0XFFFFFFFF;
+    slot->dirty = false;
+    slot->mirror = 0;
+  }
+}
+//------------------------------------------------------------------------------
+// least recently used slot for a kind of block
+cache_slot_t* SdVolume::cacheVictim(uint8_t kind) {
+  uint8_t first = 0;
+  uint8_t count = SD_CACHE_DATA_SLOTS;
+  if (kind == CACHE_META && SD_CACHE_META_SLOTS) {
+    first = SD_CACHE_DATA_SLOTS;
+    count = SD_CACHE_META_SLOTS;
+  }
+  cache_slot_t* victim = &cacheSlot_[first];
+  for (uint8_t i = 1; i < count; i++) {
+    cache_slot_t* slot = &cacheSlot_[first + i];
+    if (victim->block == 0XFFFFFFFF) break;
+    if (slot->block == 0XFFFFFFFF ||
+      (uint16_t)(cacheTick_ - slot->used) > (uint16_t)(cacheTick_ - victim->used)) {
+      victim = slot;
+    }
+  }
+  return victim;
+}
+//------------------------------------------------------------------------------
+// write a slot back to the card if it is dirty
+bool SdVolume::cacheWriteBack(cache_slot_t* slot) {
+  if (slot->dirty) {
+    if (!writeBlock(slot->block, slot->buf.data)) {
       goto fail;
     }
     // mirror FAT tables
-    if (cacheMirrorBlock_) {
-      if (!sdCard_->writeBlock(cacheMirrorBlock_, cacheBuffer_.data)) {
+    if (slot->mirror) {
+      if (!writeBlock(slot->mirror, slot->buf.data)) {
         goto fail;
       }
-      cacheMirrorBlock_ = 0;
+      slot->mirror = 0;
     }
-    cacheDirty_ = 0;
+    slot->dirty = false;
   }
   return true;
 
@@ -124,20 +174,96 @@ bool SdVolume::cacheFlush() {
   return false;
 }
 //------------------------------------------------------------------------------
-bool SdVolume::cacheRawBlock(uint32_t blockNumber, bool dirty) {
-  if (cacheBlockNumber_ != blockNumber) {
-    if (!cacheFlush()) goto fail;
-    if (!sdCard_->readBlock(blockNumber, cacheBuffer_.data)) goto fail;
-    cacheBlockNumber_ = blockNumber;
+bool SdVolume::cacheRawBlock(uint32_t blockNumber, bool dirty, uint8_t kind) {
+  cache_slot_t* slot = cacheFind(blockNumber);
+  if (slot) {
+    cacheHits_[kind]++;
+  } else {
+    cacheMisses_[kind]++;
+    slot = cacheVictim(kind);
+    if (!cacheWriteBack(slot)) goto fail;
+    if (!readBlock(blockNumber, slot->buf.data)) {
+      slot->block = 0XFFFFFFFF;
+      goto fail;
+    }
+    slot->block = blockNumber;
   }
-  if (dirty) cacheDirty_ = true;
+  slot->used = ++cacheTick_;
+  if (dirty) slot->dirty = true;
+  cacheCur_ = slot;
   return true;
 
  fail:
-  cacheBlockNumber_ = 0XFFFFFFFF;
   return false;
 }
 //------------------------------------------------------------------------------
+// used by SdBaseFile write to assign a cache slot to a block without
+// reading it, the slot is marked dirty
+bool SdVolume::cacheSetBlockNumber(uint32_t blockNumber, uint8_t kind) {
+  cache_slot_t* slot = cacheFind(blockNumber);
+  if (!slot) {
+    slot = cacheVictim(kind);
+    if (!cacheWriteBack(slot)) return false;
+    slot->block = blockNumber;
+  }
+  slot->used = ++cacheTick_;
+  slot->dirty = true;
+  cacheCur_ = slot;
+  return true;
+}
+//------------------------------------------------------------------------------
+/** Write a block, as part of the write stream if it is the next block.
+ *
+ * The multiple block write on the card is opened when the first block of
+ * the stream is written, and again after it was paused by other I/O.
+ */
+bool SdVolume::writeBlock(uint32_t block, const uint8_t* src) {
+  if (block == writeStreamBlock_) {
+    if (!writeStreamOpen_) {
+      if (!sdCard_->writeStart(block, writeStreamEnd_ - block)) goto fail;
+      writeStreamOpen_ = true;
+    }
+    if (!sdCard_->writeData(src)) goto fail;
+    if (++writeStreamBlock_ == writeStreamEnd_) return writeStreamStop();
+    return true;
+  }
+  if (!writeStreamPause()) return false;
+  return sdCard_->writeBlock(block, src);
+
+ fail:
+  writeStreamStop();
+  return false;
+}
+//------------------------------------------------------------------------------
+/** Announce that a range of blocks will be written in sequence.
+ *
+ * A range that directly follows the current stream extends it.
+ */
+bool SdVolume::writeStreamStart(uint32_t block, uint32_t count) {
+  if (writeStreamBlock_ != 0XFFFFFFFF && block == writeStreamEnd_) {
+    writeStreamEnd_ += count;
+    return true;
+  }
+  if (!writeStreamStop()) return false;
+  writeStreamBlock_ = block;
+  writeStreamEnd_ = block + count;
+  return true;
+}
+//------------------------------------------------------------------------------
+// end the multiple block write on the card but keep the stream position,
+// required before any other command is sent to the card
+bool SdVolume::writeStreamPause() {
+  if (!writeStreamOpen_) return true;
+  writeStreamOpen_ = false;
+  return sdCard_->writeStop();
+}
+//------------------------------------------------------------------------------
+// end the write stream
+bool SdVolume::writeStreamStop() {
+  writeStreamBlock_ = 0XFFFFFFFF;
+  return writeStreamPause();
+}
+//------------------------------------------------------------------------------
 // return the size in bytes of a cluster chain
 bool SdVolume::chainSize(uint32_t cluster, uint32_t* size) {
   uint32_t s = 0;
@@ -160,15 +286,15 @@ bool SdVolume::fatGet(uint32_t cluster, uint32_t* value) {
     uint16_t index = cluster;
     index += index >> 1;
     lba = fatStartBlock_ + (index >> 9);
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) goto fail;
+    if (!cacheRawBlock(lba, CACHE_FOR_READ, CACHE_META)) goto fail;
     index &= 0X1FF;
-    uint16_t tmp = cacheBuffer_.data[index];
+    uint16_t tmp = cache()->data[index];
     index++;
     if (index == 512) {
-      if (!cacheRawBlock(lba + 1, CACHE_FOR_READ)) goto fail;
+      if (!cacheRawBlock(lba + 1, CACHE_FOR_READ, CACHE_META)) goto fail;
       index = 0;
     }
-    tmp |= cacheBuffer_.data[index] << 8;
+    tmp |= cache()->data[index] << 8;
     *value = cluster & 1 ? tmp >> 4 : tmp & 0XFFF;
     return true;
   }
@@ -179,13 +305,11 @@ bool SdVolume::fatGet(uint32_t cluster, uint32_t* value) {
   } else {
     goto fail;
   }
-  if (lba != cacheBlockNumber_) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) goto fail;
-  }
+  if (!cacheRawBlock(lba, CACHE_FOR_READ, CACHE_META)) goto fail;
   if (fatType_ == 16) {
-    *value = cacheBuffer_.fat16[cluster & 0XFF];
+    *value = cache()->fat16[cluster & 0XFF];
   } else {
-    *value = cacheBuffer_.fat32[cluster & 0X7F] & FAT32MASK;
+    *value = cache()->fat32[cluster & 0X7F] & FAT32MASK;
   }
   return true;
 
@@ -206,28 +330,28 @@ bool SdVolume::fatPut(uint32_t cluster, uint32_t value) {
     uint16_t index = cluster;
     index += index >> 1;
     lba = fatStartBlock_ + (index >> 9);
-    if (!cacheRawBlock(lba, CACHE_FOR_WRITE)) goto fail;
+    if (!cacheRawBlock(lba, CACHE_FOR_WRITE, CACHE_META)) goto fail;
     // mirror second FAT
-    if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
+    if (fatCount_ > 1) cacheCur_->mirror = lba + blocksPerFat_;
     index &= 0X1FF;
     uint8_t tmp = value;
     if (cluster & 1) {
-      tmp = (cacheBuffer_.data[index] & 0XF) | tmp << 4;
+      tmp = (cache()->data[index] & 0XF) | tmp << 4;
     }
-    cacheBuffer_.data[index] = tmp;
+    cache()->data[index] = tmp;
     index++;
     if (index == 512) {
       lba++;
       index = 0;
-      if (!cacheRawBlock(lba, CACHE_FOR_WRITE)) goto fail;
+      if (!cacheRawBlock(lba, CACHE_FOR_WRITE, CACHE_META)) goto fail;
       // mirror second FAT
-      if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
+      if (fatCount_ > 1) cacheCur_->mirror = lba + blocksPerFat_;
     }
     tmp = value >> 4;
     if (!(cluster & 1)) {
-      tmp = ((cacheBuffer_.data[index] & 0XF0)) | tmp >> 4;
+      tmp = ((cache()->data[index] & 0XF0)) | tmp >> 4;
     }
-    cacheBuffer_.data[index] = tmp;
+    cache()->data[index] = tmp;
     return true;
   }
   if (fatType_ == 16) {
@@ -237,15 +361,15 @@ bool SdVolume::fatPut(uint32_t cluster, uint32_t value) {
   } else {
     goto fail;
   }
-  if (!cacheRawBlock(lba, CACHE_FOR_WRITE)) goto fail;
+  if (!cacheRawBlock(lba, CACHE_FOR_WRITE, CACHE_META)) goto fail;
   // store entry
   if (fatType_ == 16) {
-    cacheBuffer_.fat16[cluster & 0XFF] = value;
+    cache()->fat16[cluster & 0XFF] = value;
   } else {
-    cacheBuffer_.fat32[cluster & 0X7F] = value;
+    cache()->fat32[cluster & 0X7F] = value;
   }
   // mirror second FAT
-  if (fatCount_ > 1) cacheMirrorBlock_ = lba + blocksPerFat_;
+  if (fatCount_ > 1) cacheCur_->mirror = lba + blocksPerFat_;
   return true;
 
  fail:
@@ -293,15 +417,15 @@ int32_t SdVolume::freeClusterCount() {
   }
 
   for (uint32_t lba = fatStartBlock_; todo; todo -= n, lba++) {
-    if (!cacheRawBlock(lba, CACHE_FOR_READ)) return -1;
+    if (!cacheRawBlock(lba, CACHE_FOR_READ, CACHE_META)) return -1;
     if (todo < n) n = todo;
     if (fatType_ == 16) {
       for (uint16_t i = 0; i < n; i++) {
-        if (cacheBuffer_.fat16[i] == 0) free++;
+        if (cache()->fat16[i] == 0) free++;
       }
     } else {
       for (uint16_t i = 0; i < n; i++) {
-        if (cacheBuffer_.fat32[i] == 0) free++;
+        if (cache()->fat32[i] == 0) free++;
       }
     }
   }
@@ -330,16 +454,21 @@ bool SdVolume::init(Sd2Card* dev, uint8_t part) {
   sdCard_ = dev;
   fatType_ = 0;
   allocSearchStart_ = 2;
-  cacheDirty_ = 0;  // cacheFlush() will write block if true
-  cacheMirrorBlock_ = 0;
-  cacheBlockNumber_ = 0XFFFFFFFF;
+  for (uint8_t i = 0; i < SD_CACHE_SLOTS; i++) {
+    cacheSlot_[i].block = 0XFFFFFFFF;
+    cacheSlot_[i].mirror = 0;
+    cacheSlot_[i].dirty = false;
+  }
+  cacheCur_ = cacheSlot_;
+  writeStreamBlock_ = 0XFFFFFFFF;
+  writeStreamOpen_ = false;
 
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
     if (part > 4)goto fail;
-    if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) goto fail;
-    part_t* p = &cacheBuffer_.mbr.part[part-1];
+    if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ, CACHE_META)) goto fail;
+    part_t* p = &cache()->mbr.part[part-1];
     if ((p->boot & 0X7F) !=0  ||
       p->totalSectors < 100 ||
       p->firstSector == 0) {
@@ -348,8 +477,8 @@ bool SdVolume::init(Sd2Card* dev, uint8_t part) {
     }
     volumeStartBlock = p->firstSector;
   }
-  if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ)) goto fail;
-  fbs = &cacheBuffer_.fbs32;
+  if (!cacheRawBlock(volumeStartBlock, CACHE_FOR_READ, CACHE_META)) goto fail;
+  fbs = &cache()->fbs32;
   if (fbs->bytesPerSector != 512 ||
     fbs->fatCount == 0 ||
     fbs->reservedSectorCount == 0 ||
@@ -53,6 +53,19 @@ union cache_t {
   fat32_fsinfo_t fsinfo;
 };
 //------------------------------------------------------------------------------
+/** Total number of block cache slots */
+#define SD_CACHE_SLOTS (SD_CACHE_DATA_SLOTS + SD_CACHE_META_SLOTS)
+/**
+ * \brief A block cache slot and its state
+ */
+struct cache_slot_t {
+  cache_t  buf;     // 512 byte cache for a device block
+  uint32_t block;   // logical number of the block, 0XFFFFFFFF if unused
+  uint32_t mirror;  // block number for mirror FAT, zero if none
+  uint16_t used;    // cache tick of the last access, for LRU eviction
+  bool     dirty;   // cacheFlush() will write block if true
+};
+//------------------------------------------------------------------------------
 /**
  * \class SdVolume
  * \brief Access FAT16 and FAT32 volumes on SD and SDHC cards.
@@ -67,8 +80,9 @@ class SdVolume {
    */
   cache_t* cacheClear() {
     if (!cacheFlush()) return 0;
-    cacheBlockNumber_ = 0XFFFFFFFF;
-    return &cacheBuffer_;
+    cacheCur_ = cacheSlot_;
+    cacheCur_->block = 0XFFFFFFFF;
+    return &cacheCur_->buf;
   }
   /** Initialize a FAT volume.  Try partition one first then try super
    * floppy format.
@@ -117,10 +131,25 @@ class SdVolume {
    * \return true for success or false for failure
    */
   bool dbgFat(uint32_t n, uint32_t* v) {return fatGet(n, v);}
+
+  /** cacheHits()/cacheMisses() index for file data blocks */
+  static uint8_t const CACHE_DATA = 0;
+  /** cacheHits()/cacheMisses() index for FAT and directory blocks */
+  static uint8_t const CACHE_META = 1;
+  /** \return Number of block lookups of a kind served from the cache. */
+  uint32_t cacheHits(uint8_t kind) const {return cacheHits_[kind];}
+  /** \return Number of block lookups of a kind that read the card. */
+  uint32_t cacheMisses(uint8_t kind) const {return cacheMisses_[kind];}
+  /** Reset the cache hit and miss counters. */
+  void cacheResetStats() {
+    memset(cacheHits_, 0, sizeof(cacheHits_));
+    memset(cacheMisses_, 0, sizeof(cacheMisses_));
+  }
 //------------------------------------------------------------------------------
  private:
   // Allow SdBaseFile access to SdVolume private data.
   friend class SdBaseFile;
+  friend class SdExtentMap;
 
   // value for dirty argument in cacheRawBlock to indicate read from cache
   static bool const CACHE_FOR_READ = false;
@@ -128,17 +157,25 @@ class SdVolume {
   static bool const CACHE_FOR_WRITE = true;
 
 #if USE_MULTIPLE_CARDS
-  cache_t cacheBuffer_;        // 512 byte cache for device blocks
-  uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+  cache_slot_t cacheSlot_[SD_CACHE_SLOTS];  // data slots first, then metadata
+  cache_slot_t* cacheCur_;     // slot of the last cached block
+  uint16_t cacheTick_;         // access counter for LRU eviction
+  uint32_t cacheHits_[2];      // lookups served from cache, by kind
+  uint32_t cacheMisses_[2];    // lookups that read the card, by kind
   Sd2Card* sdCard_;            // Sd2Card object for cache
-  bool cacheDirty_;            // cacheFlush() will write block if true
-  uint32_t cacheMirrorBlock_;  // block number for mirror FAT
+  uint32_t writeStreamBlock_;  // next block of the write stream, 0XFFFFFFFF if none
+  uint32_t writeStreamEnd_;    // first block past the write stream
+  bool writeStreamOpen_;       // card is in a multiple block write
 #else  // USE_MULTIPLE_CARDS
-  static cache_t cacheBuffer_;        // 512 byte cache for device blocks
-  static uint32_t cacheBlockNumber_;  // Logical number of block in the cache
+  static cache_slot_t cacheSlot_[SD_CACHE_SLOTS];  // data slots first, then metadata
+  static cache_slot_t* cacheCur_;     // slot of the last cached block
+  static uint16_t cacheTick_;         // access counter for LRU eviction
+  static uint32_t cacheHits_[2];      // lookups served from cache, by kind
+  static uint32_t cacheMisses_[2];    // lookups that read the card, by kind
   static Sd2Card* sdCard_;            // Sd2Card object for cache
-  static bool cacheDirty_;            // cacheFlush() will write block if true
-  static uint32_t cacheMirrorBlock_;  // block number for mirror FAT
+  static uint32_t writeStreamBlock_;  // next block of the write stream, 0XFFFFFFFF if none
+  static uint32_t writeStreamEnd_;    // first block past the write stream
+  static bool writeStreamOpen_;       // card is in a multiple block write
 #endif  // USE_MULTIPLE_CARDS
   uint32_t allocSearchStart_;   // start cluster for alloc search
   uint8_t blocksPerCluster_;    // cluster size in blocks
@@ -159,21 +196,27 @@ class SdVolume {
            return dataStartBlock_ + ((cluster - 2) << clusterSizeShift_);}
   uint32_t blockNumber(uint32_t cluster, uint32_t position) const {
            return clusterStartBlock(cluster) + blockOfCluster(position);}
-  cache_t *cache() {return &cacheBuffer_;}
-  uint32_t cacheBlockNumber() {return cacheBlockNumber_;}
+  cache_t *cache() {return &cacheCur_->buf;}
+  uint32_t cacheBlockNumber() {return cacheCur_->block;}
+  bool cacheContains(uint32_t blockNumber) {return cacheFind(blockNumber) != 0;}
 #if USE_MULTIPLE_CARDS
   bool cacheFlush();
-  bool cacheRawBlock(uint32_t blockNumber, bool dirty);
+  bool cacheRawBlock(uint32_t blockNumber, bool dirty, uint8_t kind);
+  bool cacheSetBlockNumber(uint32_t blockNumber, uint8_t kind);
+  cache_slot_t* cacheFind(uint32_t blockNumber);
+  void cacheInvalidate(uint32_t blockNumber);
+  cache_slot_t* cacheVictim(uint8_t kind);
+  bool cacheWriteBack(cache_slot_t* slot);
 #else  // USE_MULTIPLE_CARDS
   static bool cacheFlush();
-  static bool cacheRawBlock(uint32_t blockNumber, bool dirty);
+  static bool cacheRawBlock(uint32_t blockNumber, bool dirty, uint8_t kind);
+  static bool cacheSetBlockNumber(uint32_t blockNumber, uint8_t kind);
+  static cache_slot_t* cacheFind(uint32_t blockNumber);
+  static void cacheInvalidate(uint32_t blockNumber);
+  static cache_slot_t* cacheVictim(uint8_t kind);
+  static bool cacheWriteBack(cache_slot_t* slot);
 #endif  // USE_MULTIPLE_CARDS
-  // used by SdBaseFile write to assign cache to SD location
-  void cacheSetBlockNumber(uint32_t blockNumber, bool dirty) {
-    cacheDirty_ = dirty;
-    cacheBlockNumber_  = blockNumber;
-  }
-  void cacheSetDirty() {cacheDirty_ |= CACHE_FOR_WRITE;}
+  void cacheSetDirty() {cacheCur_->dirty = true;}
   bool chainSize(uint32_t beginCluster, uint32_t* size);
   bool fatGet(uint32_t cluster, uint32_t* value);
   bool fatPut(uint32_t cluster, uint32_t value);
@@ -186,11 +229,21 @@ class SdVolume {
     if (fatType_ == 16) return cluster >= FAT16EOC_MIN;
     return  cluster >= FAT32EOC_MIN;
   }
+#if USE_MULTIPLE_CARDS
   bool readBlock(uint32_t block, uint8_t* dst) {
-    return sdCard_->readBlock(block, dst);}
-  bool writeBlock(uint32_t block, const uint8_t* dst) {
-    return sdCard_->writeBlock(block, dst);
-  }
+    return writeStreamPause() && sdCard_->readBlock(block, dst);}
+  bool writeBlock(uint32_t block, const uint8_t* src);
+  bool writeStreamStart(uint32_t block, uint32_t count);
+  bool writeStreamPause();
+  bool writeStreamStop();
+#else  // USE_MULTIPLE_CARDS
+  static bool readBlock(uint32_t block, uint8_t* dst) {
+    return writeStreamPause() && sdCard_->readBlock(block, dst);}
+  static bool writeBlock(uint32_t block, const uint8_t* src);
+  static bool writeStreamStart(uint32_t block, uint32_t count);
+  static bool writeStreamPause();
+  static bool writeStreamStop();
+#endif  // USE_MULTIPLE_CARDS
 //------------------------------------------------------------------------------
   // Deprecated functions  - suppress cpplint warnings with NOLINT comment
 #if ALLOW_DEPRECATED_FUNCTIONS && !defined(DOXYGEN)
@@ -15,6 +15,7 @@
 #include "pins.h"
 #include "preferences.h"
 #include "tinkergnome.h"
+#include "print_journal.h"
 
 // coefficient for the exponential moving average
 // K1 defined in Configuration.h in the PID settings
@@ -33,6 +34,61 @@ char lcd_status_message[LCD_CHARS_PER_LINE+1] = {0};
 // #define MILLIS_GLOW  (25L)
 static unsigned long glow_millis;
 
+#ifdef LCD_RENDER_GOVERNOR
+static unsigned long frame_millis;
+static uint16_t frame_key;
+static bool frame_animated;
+static bool frame_invalid = true;
+
+static uint16_t frame_key_add(uint16_t key, uint16_t value)
+{
+    return ((key << 5) | (key >> 11)) ^ value;
+}
+
+// checksum of everything the menus show that can change without the buttons being used
+static uint16_t lcd_frame_key()
+{
+    uint16_t key = frame_key_add(0, (uint16_t)(uintptr_t)menu.currentMenu().processMenuFunc);
+    key = frame_key_add(key, lcd_lib_encoder_pos);
+    key = frame_key_add(key, (printing_state << 8) | card.percentDone());
+    key = frame_key_add(key, (sleep_state << 8) | (card.sdInserted() << 1) | HAS_SERIAL_CMD);
+    for(uint8_t e=0; e<EXTRUDERS; ++e)
+    {
+        key = frame_key_add(key, int(dsp_temperature[e] + 0.5));
+        key = frame_key_add(key, target_temperature[e]);
+    }
+#if TEMP_SENSOR_BED != 0
+    key = frame_key_add(key, int(dsp_temperature_bed + 0.5));
+    key = frame_key_add(key, target_temperature_bed);
+#endif
+    return key;
+}
+
+// decide if the menu is drawn this pass
+static bool lcd_frame_due(unsigned long m)
+{
+    if (m - frame_millis < 1000UL / LCD_MAX_FPS)
+        return false;
+    uint16_t key = lcd_frame_key();
+    if (frame_invalid || frame_animated || key != frame_key || IsStopped()
+      || m - frame_millis >= LCD_IDLE_REDRAW
+      || m - last_user_interaction < LCD_IDLE_REDRAW
+      || lcd_lib_buttons_changed() || card.sdInserted() != IS_SD_INSERTED)
+    {
+        frame_millis = m;
+        frame_key = key;
+        frame_invalid = false;
+        return true;
+    }
+    return false;
+}
+
+void lcd_invalidate()
+{
+    frame_invalid = true;
+}
+#endif
+
 static void lcd_menu_startup();
 #ifdef SPECIAL_STARTUP
 static void lcd_menu_special_startup();
@@ -81,9 +137,23 @@ void lcd_update()
             led_glow+=2;
             if (led_glow >= 126) led_glow_dir = 1;
         }
+
+        // refresh the displayed temperatures
+        for(uint8_t e=0; e<EXTRUDERS; ++e)
+        {
+            dsp_temperature[e] = (K2 * current_temperature[e]) + (K1 * dsp_temperature[e]);
+        }
+#if TEMP_SENSOR_BED != 0
+        dsp_temperature_bed = (K2 * current_temperature_bed) + (K1 * dsp_temperature_bed);
+#endif
     }
 
     if (!lcd_lib_update_ready()) return;
+#ifdef LCD_RENDER_GOVERNOR
+    if (!lcd_frame_due(m)) return;
+    // a menu that changes the led color every frame is animated, keep drawing it at the full frame rate
+    uint8_t r = led_r, g = led_g, b = led_b;
+#endif
     lcd_lib_buttons_update();
     card.updateSDInserted();
 
@@ -170,14 +240,8 @@ void lcd_update()
     {
         postMenuCheck();
     }
-
-    // refresh the displayed temperatures
-    for(uint8_t e=0; e<EXTRUDERS; ++e)
-    {
-        dsp_temperature[e] = (K2 * current_temperature[e]) + (K1 * dsp_temperature[e]);
-    }
-#if TEMP_SENSOR_BED != 0
-    dsp_temperature_bed = (K2 * current_temperature_bed) + (K1 * dsp_temperature_bed);
+#ifdef LCD_RENDER_GOVERNOR
+    frame_animated = (r != led_r || g != led_g || b != led_b);
 #endif
 }
 
@@ -227,6 +291,10 @@ void lcd_menu_startup()
         if (IS_FIRST_RUN_DONE())
         {
             menu.return_to_previous(false);
+#ifdef POWER_LOSS_JOURNAL
+            if (journal_interrupted())
+                menu.add_menu(menu_t(lcd_menu_recover_journal, MAIN_MENU_ITEM_POS(0)), false);
+#endif
         }
         else
         {
@@ -273,6 +341,9 @@ void lcd_buttons_update()
 
 void lcd_setstatus(const char* message)
 {
+#ifdef LCD_RENDER_GOVERNOR
+    lcd_invalidate();
+#endif
     if (message)
     {
         strncpy(lcd_status_message, message, LCD_CHARS_PER_LINE);
@@ -285,6 +356,9 @@ void lcd_setstatus(const char* message)
 
 void lcd_clearstatus()
 {
+#ifdef LCD_RENDER_GOVERNOR
+    lcd_invalidate();
+#endif
     *lcd_status_message = '\0';
 }
 
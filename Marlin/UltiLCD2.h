@@ -12,6 +12,11 @@ void lcd_update();
 void lcd_setstatus(const char* message);
 const char * lcd_getstatus();
 void lcd_clearstatus();
+#ifdef LCD_RENDER_GOVERNOR
+void lcd_invalidate();          /* Draw the menu at the next frame, also when nothing it shows seems to have changed */
+#else
+FORCE_INLINE void lcd_invalidate() {}
+#endif
 void lcd_buttons_update();
 FORCE_INLINE void lcd_reset_alert_level() {}
 FORCE_INLINE void lcd_buzz(long duration,uint16_t freq) {}
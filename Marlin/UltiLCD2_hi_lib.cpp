@@ -29,14 +29,14 @@ uint8_t heater_timeout = 3;
 uint16_t backup_temperature[EXTRUDERS] = { 0 };
 
 //Arduino IDE compatibility, lacks the eeprom_read_float function
-float eeprom_read_float(const float* addr)
+float (eeprom_read_float)(const float* addr)
 {
     union { uint32_t i; float f; } n;
     n.i = eeprom_read_dword((uint32_t*)addr);
     return n.f;
 }
 
-void eeprom_write_float(const float* addr, float f)
+void (eeprom_write_float)(const float* addr, float f)
 {
     union { uint32_t i; float f; } n;
     n.f = f;
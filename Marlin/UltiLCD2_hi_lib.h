@@ -8,9 +8,9 @@
 
 //Arduino IDE compatibility, lacks the eeprom_read_float function
 #pragma weak eeprom_read_float
-float eeprom_read_float(const float* addr);
+float (eeprom_read_float)(const float* addr);
 #pragma weak eeprom_write_float
-void eeprom_write_float(const float* addr, float f);
+void (eeprom_write_float)(const float* addr, float f);
 
 void lcd_tripple_menu(const char* left, const char* right, const char* bottom);
 void lcd_basic_screen();
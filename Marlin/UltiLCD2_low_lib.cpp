@@ -40,12 +40,25 @@
 #define LCD_COMMAND_LOCK_COMMANDS           0xFD
 
 #define LCD_COMMAND_SET_ADDRESSING_MODE     0x20
+#define LCD_COMMAND_SET_COLUMN_ADDRESS      0x21
+#define LCD_COMMAND_SET_PAGE_ADDRESS        0x22
 
 unsigned long last_user_interaction=0;
 
 /** Backbuffer for LCD */
 #define LCD_BUFFER_SIZE  (LCD_GFX_WIDTH * LCD_GFX_HEIGHT / 8)
 uint8_t lcd_buffer[LCD_BUFFER_SIZE];
+
+/** Only the parts of the backbuffer that changed are sent. Each page (8 pixel row) is split in spans of
+    LCD_SPAN_WIDTH columns, a span is sent when its checksum differs from the one of what the display shows. */
+#define LCD_PAGES        (LCD_GFX_HEIGHT / 8)
+#define LCD_SPAN_WIDTH   32
+#define LCD_SPANS        (LCD_GFX_WIDTH / LCD_SPAN_WIDTH)
+static uint16_t lcd_span_sum[LCD_PAGES * LCD_SPANS];
+static uint8_t lcd_update_dirty[LCD_PAGES];    // spans per page that still have to be sent
+static uint8_t lcd_refresh_span = 0;
+static bool lcd_refresh_all = true;
+
 uint8_t led_r, led_g, led_b;
 uint8_t led_glow = 0;
 uint8_t led_glow_dir;
@@ -197,23 +210,129 @@ void lcd_lib_init()
     lcd_lib_buttons_update_interrupt();
     lcd_lib_buttons_update();
     lcd_lib_encoder_pos = 0;
+    // the display memory is undefined after a reset
+    lcd_refresh_all = true;
     lcd_lib_update_screen();
 }
 
-#if USE_TWI_INTERRUPT
+// mark the spans that differ from the display
+static void lcd_update_changes()
+{
+    const uint8_t* src = lcd_buffer;
+    uint16_t* sum = lcd_span_sum;
+    for (uint8_t page = 0; page < LCD_PAGES; ++page)
+    {
+        uint8_t dirty = 0;
+        for (uint8_t span = 0; span < LCD_SPANS; ++span, ++sum)
+        {
+            // Fletcher checksum, also notices moved pixels
+            uint8_t a = 0, b = 0;
+            for (uint8_t n = LCD_SPAN_WIDTH; n; --n)
+            {
+                a += *src++;
+                b += a;
+            }
+            uint16_t s = (uint16_t(b) << 8) | a;
+            if (s != *sum || lcd_refresh_all)
+            {
+                *sum = s;
+                dirty |= _BV(span);
+            }
+        }
+        lcd_update_dirty[page] = dirty;
+    }
+    // resend one span per frame as well, so a checksum collision or a garbled transfer does not stay on the screen
+    lcd_update_dirty[lcd_refresh_span / LCD_SPANS] |= _BV(lcd_refresh_span % LCD_SPANS);
+    lcd_refresh_span = (lcd_refresh_span + 1) % (LCD_PAGES * LCD_SPANS);
+    lcd_refresh_all = false;
+}
+
 volatile uint16_t lcd_update_pos = 0;
-ISR(TWI_vect)
+static uint16_t lcd_update_end;
+static uint8_t lcd_update_page;
+static uint8_t lcd_update_step;
+
+// set up the window from the first to the last changed span of the next page with changes, false when there is none
+static bool lcd_update_window()
 {
-    if (lcd_update_pos >= LCD_GFX_WIDTH*LCD_GFX_HEIGHT/8u)
+    for (; lcd_update_page < LCD_PAGES; ++lcd_update_page)
     {
-        lcd_update_pos = 0;
-        i2c_end();
+        uint8_t dirty = lcd_update_dirty[lcd_update_page];
+        if (!dirty)
+            continue;
+        uint8_t first = 0;
+        while (!(dirty & _BV(first)))
+            ++first;
+        uint8_t last = LCD_SPANS - 1;
+        while (!(dirty & _BV(last)))
+            --last;
+        lcd_update_pos = lcd_update_page * LCD_GFX_WIDTH + first * LCD_SPAN_WIDTH;
+        lcd_update_end = lcd_update_page * LCD_GFX_WIDTH + (last + 1) * LCD_SPAN_WIDTH;
+        return true;
     }
-    else
+    return false;
+}
+
+// send the next byte of the screen update, one per TWI interrupt. Every window is a command transfer that sets the
+// column and page range, followed by the data transfer. Returns false when the update is complete.
+static bool lcd_update_send()
+{
+    switch (lcd_update_step++)
     {
-        i2c_send_raw(lcd_buffer[lcd_update_pos++]);
-        TWCR |= _BV(TWIE);
+    case 0:
+    case 9:
+        i2c_send_raw(I2C_LCD_ADDRESS << 1 | I2C_WRITE);
+        break;
+    case 1:
+        i2c_send_raw(I2C_LCD_SEND_COMMAND);
+        break;
+    case 2:
+        i2c_send_raw(LCD_COMMAND_SET_COLUMN_ADDRESS);
+        break;
+    case 3:
+        i2c_send_raw(lcd_update_pos & (LCD_GFX_WIDTH - 1));
+        break;
+    case 4:
+        i2c_send_raw((lcd_update_end - 1) & (LCD_GFX_WIDTH - 1));
+        break;
+    case 5:
+        i2c_send_raw(LCD_COMMAND_SET_PAGE_ADDRESS);
+        break;
+    case 6:
+    case 7:
+        i2c_send_raw(lcd_update_page);
+        break;
+    case 8:
+        i2c_restart();
+        break;
+    case 10:
+        i2c_send_raw(I2C_LCD_SEND_DATA);
+        break;
+    default:
+        lcd_update_step = 11;
+        if (lcd_update_pos < lcd_update_end)
+        {
+            i2c_send_raw(lcd_buffer[lcd_update_pos++]);
+            break;
+        }
+        ++lcd_update_page;
+        if (lcd_update_window())
+        {
+            lcd_update_step = 0;
+            i2c_restart();
+            break;
+        }
+        i2c_end();
+        return false;
     }
+    return true;
+}
+
+#if USE_TWI_INTERRUPT
+ISR(TWI_vect)
+{
+    if (lcd_update_send())
+        TWCR |= _BV(TWIE);
 }
 #endif
 
@@ -294,32 +413,17 @@ void lcd_lib_update_screen()
 
     if (!(sleep_state & SLEEP_LCD_DIMMED) || lcd_sleep_contrast)
     {
-        // update screen content
-    #if USE_TWI_INTERRUPT
-        CRITICAL_SECTION_START
-        lcd_update_pos = 0;
-        CRITICAL_SECTION_END
-    #endif
+        // update the changed parts of the screen content
+        lcd_update_changes();
+        lcd_update_page = 0;
+        lcd_update_step = 0;
+        lcd_update_window();
         i2c_start();
-        i2c_send_raw(I2C_LCD_ADDRESS << 1 | I2C_WRITE);
-        //Set the drawing position to 0,0
-        i2c_send_raw(I2C_LCD_SEND_COMMAND);
-        i2c_send_raw(0x00 | (0 & 0x0F));
-        i2c_send_raw(0x10 | (0 >> 4));
-        i2c_send_raw(0xB0 | 0);
-
-        i2c_restart();
-        i2c_send_raw(I2C_LCD_ADDRESS << 1 | I2C_WRITE);
-        i2c_send_raw(I2C_LCD_SEND_DATA);
     #if USE_TWI_INTERRUPT
         // enable TWI interrupts
         TWCR |= _BV(TWIE);
     #else
-        for(uint16_t n=0;n<LCD_GFX_WIDTH*LCD_GFX_HEIGHT/8;n++)
-        {
-            i2c_send_raw(lcd_buffer[n]);
-        }
-        i2c_end();
+        while (lcd_update_send()) {}
     #endif
     }
 }
@@ -451,63 +555,66 @@ static const uint8_t lcd_font_7x5[] PROGMEM = {
 	0x08, 0x1C, 0x2A, 0x08, 0x08 // <-
 };
 
-void lcd_lib_draw_string(uint8_t x, uint8_t y, const char* str)
+// draw (or clear) one character at dst, each font column is read once and shifted into the two pages it covers
+static FORCE_INLINE void lcd_lib_blit_char(uint8_t* dst, uint8_t yshift, char c, bool clear)
 {
-    uint8_t* dst = lcd_buffer + x + (y >> 3) * LCD_GFX_WIDTH;
-    uint8_t* dst2 = lcd_buffer + x + (y >> 3) * LCD_GFX_WIDTH + LCD_GFX_WIDTH;
-    uint8_t yshift = y & 0x07;
-    uint8_t yshift2 = 8 - yshift;
-    while ((*str) && ((dst-lcd_buffer) < LCD_BUFFER_SIZE-FONT_CHAR_WIDTH) && ((dst2-lcd_buffer) < LCD_BUFFER_SIZE-FONT_CHAR_WIDTH))
+    const uint8_t* src = lcd_font_7x5 + (c - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
+    if (yshift == 0)
     {
-        const uint8_t* src = lcd_font_7x5 + (*str - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
-
-        for (uint8_t i = 0; i<FONT_CHAR_WIDTH; ++i, ++dst, ++src)
+        // page aligned, the glyph lies within a single page
+        for (uint8_t i=0; i<FONT_CHAR_WIDTH; ++i, ++dst, ++src)
         {
-            *dst |= pgm_read_byte(src) << yshift;
+            if (clear)
+                *dst &= ~pgm_read_byte(src);
+            else
+                *dst |= pgm_read_byte(src);
         }
-        ++dst;
-
-        if (yshift != 0)
+    }
+    else
+    {
+        for (uint8_t i=0; i<FONT_CHAR_WIDTH; ++i, ++dst, ++src)
         {
-            src = lcd_font_7x5 + (*str - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
-            for (uint8_t i=0; i<FONT_CHAR_WIDTH; ++i, ++dst2, ++src)
+            uint16_t bits = uint16_t(pgm_read_byte(src)) << yshift;
+            if (clear)
             {
-                *dst2 |= pgm_read_byte(src) >> yshift2;
+                dst[0] &= ~uint8_t(bits);
+                dst[LCD_GFX_WIDTH] &= ~uint8_t(bits >> 8);
+            }
+            else
+            {
+                dst[0] |= uint8_t(bits);
+                dst[LCD_GFX_WIDTH] |= uint8_t(bits >> 8);
             }
-            ++dst2;
         }
-        str++;
     }
 }
 
-void lcd_lib_clear_string(uint8_t x, uint8_t y, const char* str)
+// No overwrite mode that also clears the background of each glyph cell: every screen, the printing screens included,
+// is drawn from lcd_lib_clear()/lcd_basic_screen() on each frame, so the cells are already clear.
+static FORCE_INLINE void lcd_lib_blit_string(uint8_t x, uint8_t y, const char* str, bool progmem, bool clear)
 {
     uint8_t* dst = lcd_buffer + x + (y >> 3) * LCD_GFX_WIDTH;
-    uint8_t* dst2 = lcd_buffer + x + (y >> 3) * LCD_GFX_WIDTH + LCD_GFX_WIDTH;
     uint8_t yshift = y & 0x07;
-    uint8_t yshift2 = 8 - yshift;
-    while ((*str) && ((dst-lcd_buffer) < LCD_BUFFER_SIZE-FONT_CHAR_WIDTH) && ((dst2-lcd_buffer) < LCD_BUFFER_SIZE-FONT_CHAR_WIDTH))
-    {
-        const uint8_t* src = lcd_font_7x5 + (*str - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
-        for (uint8_t i=0; i<FONT_CHAR_WIDTH; ++i, ++dst, ++src)
-        {
-            *dst &= ~(pgm_read_byte(src) << yshift);
-        }
-        ++dst;
+    // unaligned glyphs are blitted into two pages, both of them have to be within the buffer
+    const uint8_t* end = lcd_buffer + LCD_BUFFER_SIZE - FONT_CHAR_WIDTH - (yshift ? LCD_GFX_WIDTH : 0);
 
-        if (yshift != 0)
-        {
-            src = lcd_font_7x5 + (*str - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
-            for(uint8_t i=0; i<FONT_CHAR_WIDTH; ++i, ++dst2, ++src)
-            {
-                *dst2 &= ~(pgm_read_byte(src) >> yshift2);
-            }
-            ++dst2;
-        }
-        str++;
+    for (char c = progmem ? pgm_read_byte(str) : *str; c && dst < end; c = progmem ? pgm_read_byte(++str) : *++str)
+    {
+        lcd_lib_blit_char(dst, yshift, c, clear);
+        dst += LCD_CHAR_SPACING;
     }
 }
 
+void lcd_lib_draw_string(uint8_t x, uint8_t y, const char* str)
+{
+    lcd_lib_blit_string(x, y, str, false, false);
+}
+
+void lcd_lib_clear_string(uint8_t x, uint8_t y, const char* str)
+{
+    lcd_lib_blit_string(x, y, str, false, true);
+}
+
 void line_entry_pos_update (uint16_t maxStep)
 {
 	if (lineEntryPos > maxStep) lineEntryPos = 0;
@@ -542,61 +649,12 @@ void lcd_lib_clear_string_center(uint8_t y, const char* str)
 
 void lcd_lib_draw_stringP(uint8_t x, uint8_t y, const char* pstr)
 {
-    uint8_t* dst = lcd_buffer + x + (y >> 3) * LCD_GFX_WIDTH;
-    uint8_t* dst2 = lcd_buffer + x + (y >> 3) * LCD_GFX_WIDTH + LCD_GFX_WIDTH;
-    uint8_t yshift = y & 0x07;
-    uint8_t yshift2 = 8 - yshift;
-
-    for(char c = pgm_read_byte(pstr); c && ((dst-lcd_buffer) < LCD_BUFFER_SIZE-FONT_CHAR_WIDTH) && ((dst2-lcd_buffer) < LCD_BUFFER_SIZE-FONT_CHAR_WIDTH); c = pgm_read_byte(++pstr))
-    {
-        const uint8_t* src = lcd_font_7x5 + (c - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
-
-        for (uint8_t i=0; i<FONT_CHAR_WIDTH; ++i, ++dst, ++src)
-        {
-            *dst = (*dst) | pgm_read_byte(src) << yshift;
-        }
-        ++dst;
-
-        if (yshift != 0)
-        {
-            src = lcd_font_7x5 + (c - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
-            for (uint8_t vline=0; vline < FONT_CHAR_WIDTH; ++vline, ++dst2, ++src)
-            {
-                *dst2 = (*dst2) | pgm_read_byte(src) >> yshift2;
-            }
-            ++dst2;
-        }
-    }
+    lcd_lib_blit_string(x, y, pstr, true, false);
 }
 
 void lcd_lib_clear_stringP(uint8_t x, uint8_t y, const char* pstr)
 {
-    uint8_t* dst = lcd_buffer + x + (y >> 3) * LCD_GFX_WIDTH;
-    uint8_t* dst2 = lcd_buffer + x + (y >> 3) * LCD_GFX_WIDTH + LCD_GFX_WIDTH;
-    uint8_t yshift = y & 0x07;
-    uint8_t yshift2 = 8 - yshift;
-
-    for(char c = pgm_read_byte(pstr); c && ((dst-lcd_buffer) < LCD_BUFFER_SIZE-FONT_CHAR_WIDTH) && ((dst2-lcd_buffer) < LCD_BUFFER_SIZE-FONT_CHAR_WIDTH); c = pgm_read_byte(++pstr))
-    {
-        const uint8_t* src = lcd_font_7x5 + (c - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
-
-        for (uint8_t i=0; i<FONT_CHAR_WIDTH; ++i, ++dst, ++src)
-        {
-            *dst &= ~(pgm_read_byte(src) << yshift);
-        }
-        ++dst;
-
-        if (yshift != 0)
-        {
-            src = lcd_font_7x5 + (c - FONT_BASE_CHAR) * FONT_CHAR_WIDTH;
-
-            for (uint8_t vline=0; vline < FONT_CHAR_WIDTH; ++vline, ++dst2, ++src)
-            {
-                *dst2 &= ~(pgm_read_byte(src) >> yshift2);
-            }
-            ++dst2;
-        }
-    }
+    lcd_lib_blit_string(x, y, pstr, true, true);
 }
 
 void lcd_lib_draw_string_centerP(uint8_t y, const char* pstr)
@@ -967,6 +1025,11 @@ void lcd_lib_buttons_update()
     lcd_lib_encoder_pos_interrupt = 0;
 }
 
+bool lcd_lib_buttons_changed()
+{
+    return lcd_lib_encoder_pos_interrupt != 0 || lcd_lib_button_down != !READ(BTN_ENC);
+}
+
 char* int_to_string(int i, char* temp_buffer, const char* p_postfix, const char* p_prefix, bool bForceSign)
 {
     char* c = temp_buffer;
@@ -36,6 +36,7 @@ void lcd_lib_tick();
 void lcd_lib_keyclick();
 void lcd_lib_buttons_update();
 void lcd_lib_buttons_update_interrupt();
+bool lcd_lib_buttons_changed();     /* True when lcd_lib_buttons_update would see the encoder turned or the button change */
 void lcd_lib_led_color(uint8_t r, uint8_t g, uint8_t b);
 void lcd_lib_contrast(uint8_t data);
 
@@ -43,6 +44,7 @@ extern int16_t lcd_lib_encoder_pos;
 extern bool lcd_lib_button_pressed;
 extern bool lcd_lib_button_down;
 extern unsigned long last_user_interaction;
+extern uint8_t led_r, led_g, led_b;
 extern uint8_t led_glow;
 extern uint8_t led_glow_dir;
 
@@ -18,6 +18,7 @@
 #include "tinkergnome.h"
 #include "commandbuffer.h"
 #include "powerbudget.h"
+#include "memory_stats.h"
 #if (EXTRUDERS > 1)
 #include "UltiLCD2_menu_dual.h"
 #endif
@@ -27,6 +28,7 @@ static void lcd_menu_maintenance_advanced_heatup();
 static void lcd_menu_maintenance_extrude();
 static void lcd_menu_advanced_version();
 static void lcd_menu_advanced_stats();
+static void lcd_menu_advanced_memory();
 static void lcd_menu_maintenance_motion();
 static void lcd_menu_advanced_factory_reset();
 static void lcd_menu_preferences();
@@ -162,6 +164,8 @@ static void lcd_preferences_item(uint8_t nr, uint8_t offsetY, uint8_t flags)
         strcpy_P(buffer, PSTR("Version"));
     else if (nr == index++)
         strcpy_P(buffer, PSTR("Runtime stats"));
+    else if (nr == index++)
+        strcpy_P(buffer, PSTR("Memory usage"));
     else if (nr == index++)
         strcpy_P(buffer, PSTR("Factory reset"));
 
@@ -246,6 +250,10 @@ static void lcd_preferences_details(uint8_t nr)
     {
         strcpy_P(buffer, PSTR(STRING_CONFIG_H_AUTHOR));
     }
+    else if (nr == 15)
+    {
+        int_to_string(stack_free_min(), buffer, PSTR(" bytes"), PSTR("Lowest free: "));
+    }
     else
     {
         return;
@@ -546,9 +554,25 @@ static void lcd_menu_advanced_stats()
     lcd_lib_update_screen();
 }
 
+static void lcd_menu_advanced_memory()
+{
+    lcd_info_screen(NULL, lcd_change_to_previous_menu, PSTR("Return"));
+    char buffer[24] = {0};
+    int_to_string(ram_static_size(), buffer, NULL, PSTR("Static: "));
+    lcd_lib_draw_string_center(5, buffer);
+    int_to_string(ram_heap_size(), buffer, NULL, PSTR("Heap: "));
+    lcd_lib_draw_string_center(15, buffer);
+    int_to_string(freeMemory(), buffer, NULL, PSTR("Free: "));
+    lcd_lib_draw_string_center(25, buffer);
+    int_to_string(stack_free_min(), buffer, NULL, PSTR("Lowest free: "));
+    lcd_lib_draw_string_center(35, buffer);
+    lcd_lib_update_screen();
+}
+
 static void doMachineRestart()
 {
     cli();
+    eeprom_queue_flush();
     //NOTE: Jumping to address 0 is not a fully proper way to reset.
     // Letting the watchdog timeout is a better reset, but the bootloader does not continue on a watchdog timeout.
     // So we disable interrupts and hope for the best!
@@ -909,9 +933,9 @@ static void lcd_menu_screen_contrast()
 static void lcd_menu_preferences()
 {
 #if FAN2_PIN != LED_PIN
-    lcd_scroll_menu(PSTR("PREFERENCES"), BED_MENU_OFFSET + 15, lcd_preferences_item, lcd_preferences_details);
+    lcd_scroll_menu(PSTR("PREFERENCES"), BED_MENU_OFFSET + 16, lcd_preferences_item, lcd_preferences_details);
 #else
-    lcd_scroll_menu(PSTR("PREFERENCES"), BED_MENU_OFFSET + 14, lcd_preferences_item, lcd_preferences_details);
+    lcd_scroll_menu(PSTR("PREFERENCES"), BED_MENU_OFFSET + 15, lcd_preferences_item, lcd_preferences_details);
 #endif
     if (lcd_lib_button_pressed)
     {
@@ -952,6 +976,8 @@ static void lcd_menu_preferences()
             menu.add_menu(menu_t(lcd_menu_advanced_version, SCROLL_MENU_ITEM_POS(0)));
         else if (IS_SELECTED_SCROLL(index++))
             menu.add_menu(menu_t(lcd_menu_advanced_stats, SCROLL_MENU_ITEM_POS(0)));
+        else if (IS_SELECTED_SCROLL(index++))
+            menu.add_menu(menu_t(lcd_menu_advanced_memory, SCROLL_MENU_ITEM_POS(0)));
         else if (IS_SELECTED_SCROLL(index++))
             menu.add_menu(menu_t(lcd_menu_advanced_factory_reset, MAIN_MENU_ITEM_POS(1)));
     }
@@ -7,6 +7,8 @@
 #include "cardreader.h"
 #include "temperature.h"
 #include "lifetime_stats.h"
+#include "print_journal.h"
+#include "print_log.h"
 #include "filament_sensor.h"
 #include "UltiLCD2.h"
 #include "UltiLCD2_hi_lib.h"
@@ -158,6 +160,14 @@ void abortPrint(bool bQuickstop)
 
     stoptime=millis();
     lifetime_stats_print_end();
+#ifdef POWER_LOSS_JOURNAL
+    // after an SD card or position error the journal is kept, the print can still be recovered from it
+    if ((printing_state == PRINT_STATE_ABORT) || (printing_state == PRINT_STATE_END))
+        journal_stop();
+#endif
+#ifdef PRINT_LOG
+    print_log_stop();
+#endif
 
     printing_state = PRINT_STATE_NORMAL;
 #if FAN2_PIN != LED_PIN
@@ -325,6 +335,12 @@ void doStartPrint()
     postMenuCheck = checkPrintFinished;
     card.startFileprint();
     lifetime_stats_print_start();
+#ifdef POWER_LOSS_JOURNAL
+    journal_start();
+#endif
+#ifdef PRINT_LOG
+    print_log_start();
+#endif
     starttime = millis();
     stoptime = starttime;
     predictedTime = 0;
@@ -378,6 +378,76 @@ void LCDMenu::process_submenu(menuItemCallback_t getMenuItem, uint8_t len)
     }
 }
 
+// --------------------------------------------------------------------------
+// menu item tables
+// --------------------------------------------------------------------------
+static const menu_item_t *itemTable;
+static const menu_item_t *activeItem;
+
+static void lcd_tune_table_item()
+{
+    menu_item_t item;
+    memcpy_P(&item, activeItem, sizeof(item));
+    bool changed = false;
+    switch (item.type)
+    {
+    case MENU_ITEM_UINT8:
+        changed = lcd_tune_value(*(uint8_t *)item.value, item.min, item.max);
+        break;
+    case MENU_ITEM_INT:
+        changed = lcd_tune_value(*(int *)item.value, item.min, item.max);
+        break;
+    case MENU_ITEM_UINT16:
+        changed = lcd_tune_value(*(uint16_t *)item.value, item.min, item.max);
+        break;
+    case MENU_ITEM_PERCENT:
+        changed = lcd_tune_byte(*(uint8_t *)item.value, item.min, item.max);
+        break;
+    }
+    if (changed && item.func)
+    {
+        item.func();
+    }
+}
+
+static const menu_t & get_table_menuoption(uint8_t nr, menu_t &opt)
+{
+    menu_item_t item;
+    memcpy_P(&item, itemTable + nr, sizeof(item));
+    if (item.type == MENU_ITEM_ACTION)
+    {
+        opt.setData(MENU_NORMAL, item.func, item.accel);
+    }
+    else if (item.type == MENU_ITEM_EDIT)
+    {
+        opt.setData(MENU_INPLACE_EDIT, item.init, item.func, item.post, item.accel);
+    }
+    else
+    {
+        // the item stays active until the submenu is reset, so keep the flash address only
+        activeItem = itemTable + nr;
+        opt.setData(MENU_INPLACE_EDIT, lcd_tune_table_item, item.accel);
+    }
+    return opt;
+}
+
+void LCDMenu::process_submenu_P(const menu_item_t *items, uint8_t len)
+{
+    itemTable = items;
+    process_submenu(get_table_menuoption, len);
+}
+
+void LCDMenu::drawItemLabel_P(const menu_item_t *items, uint8_t nr, uint8_t &flags)
+{
+    const char *label;
+    memcpy_P(&label, &items[nr].label, sizeof(label));
+    if (label && (flags & (MENU_SELECTED | MENU_ACTIVE)))
+    {
+        lcd_lib_draw_string_leftP(4, label);
+        flags |= MENU_STATUSLINE;
+    }
+}
+
 void LCDMenu::drawSubMenu(menuDrawCallback_t drawFunc, uint8_t nr, uint8_t &flags)
 {
     if (drawFunc)
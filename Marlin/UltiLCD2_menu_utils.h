@@ -89,6 +89,37 @@ struct menu_t {
     }
 };
 
+// --------------------------------------------------------------------------
+// menu item tables (flash)
+// --------------------------------------------------------------------------
+// item types
+#define MENU_ITEM_ACTION   0   // func is called on click
+#define MENU_ITEM_EDIT     1   // in-place edit, func does the tuning
+#define MENU_ITEM_UINT8    2   // in-place edit of an uint8_t between min and max
+#define MENU_ITEM_INT      3   // in-place edit of an int between min and max
+#define MENU_ITEM_UINT16   4   // in-place edit of an uint16_t between min and max
+#define MENU_ITEM_PERCENT  5   // in-place edit of a 0..255 byte, shown as min..max (like lcd_tune_byte)
+
+// One submenu item, tables of these are kept in PROGMEM and read with process_submenu_P().
+// For the value types func is optional and called after each change.
+// init and post are called when an in-place edit item is activated and left.
+struct menu_item_t {
+    uint8_t     type;
+    uint8_t     accel;
+    void *      value;
+    int16_t     min;
+    int16_t     max;
+    menuFunc_t  func;
+    const char *label;      // status line text (PROGMEM) or NULL
+    menuFunc_t  init;
+    menuFunc_t  post;
+};
+
+#define MENU_ACTION(func, label)                            { MENU_ITEM_ACTION, 0, 0, 0, 0, func, label, 0, 0 }
+#define MENU_EDIT(func, accel, label)                       { MENU_ITEM_EDIT, accel, 0, 0, 0, func, label, 0, 0 }
+#define MENU_EDIT_INIT(init, func, post, accel, label)      { MENU_ITEM_EDIT, accel, 0, 0, 0, func, label, init, post }
+#define MENU_VALUE(type, var, _min, _max, accel, label)     { type, accel, &(var), _min, _max, 0, label, 0, 0 }
+
 typedef char* (*entryNameCallback_t)(uint8_t nr, char *buffer);
 typedef void (*entryDetailsCallback_t)(uint8_t nr);
 typedef const menu_t & (*menuItemCallback_t) (uint8_t nr, menu_t &opt);
@@ -119,6 +150,7 @@ public:
     }
 
     void process_submenu(menuItemCallback_t getMenuItem, uint8_t len);
+    void process_submenu_P(const menu_item_t *items, uint8_t len);
     void reset_submenu();
     void set_selection(int8_t index);
     void set_active(menuItemCallback_t getMenuItem, int8_t index);
@@ -133,6 +165,7 @@ public:
     static void drawMenuBox(uint8_t left, uint8_t top, uint8_t width, uint8_t height, uint8_t flags);
     static void drawMenuString(uint8_t left, uint8_t top, uint8_t width, uint8_t height, const char * str, uint8_t textAlign, uint8_t flags);
     static void drawMenuString_P(uint8_t left, uint8_t top, uint8_t width, uint8_t height, const char * str, uint8_t textAlign, uint8_t flags);
+    static void drawItemLabel_P(const menu_item_t *items, uint8_t nr, uint8_t &flags);
 //    static void reset_selection();
 
 private:
@@ -27,6 +27,7 @@ CardReader::CardReader() :
   #endif //SDPOWER
 
   autostart_atmillis=millis()+5000;
+  invalidateIndex();
 }
 
 char *createFilename(char *buffer, const dir_t &p) //buffer>12characters
@@ -51,7 +52,8 @@ void  CardReader::lsDive(SdFile &parent, SdFile** parents, uint8_t dirDepth)
   dir_t p;
   uint8_t cnt=0;
 
-  while (parent.readDir(&p, longFilename) > 0)
+  // entry is the directory entry the next readDir starts at, so a file can be found again by seeking there
+  for (uint16_t entry = parent.curPosition() >> 5; parent.readDir(&p, longFilename) > 0; entry = parent.curPosition() >> 5)
   {
     if( DIR_IS_SUBDIR(&p) && (lsAction!=LS_Count) && (lsAction!=LS_GetFilename)) // hence LS_SerialPrint
     {
@@ -63,7 +65,7 @@ void  CardReader::lsDive(SdFile &parent, SdFile** parents, uint8_t dirDepth)
 
       if(!dir.open(parent, lfilename, O_READ))
       {
-        if(lsAction==LS_SerialPrint)
+        if(lsAction==LS_SerialPrint || lsAction==LS_SerialPrintLong)
         {
           SERIAL_ECHO_START;
           SERIAL_ECHOLNPGM(MSG_SD_CANT_OPEN_SUBDIR);
@@ -100,7 +102,7 @@ void  CardReader::lsDive(SdFile &parent, SdFile** parents, uint8_t dirDepth)
       }
 
       createFilename(filename,p);
-      if(lsAction==LS_SerialPrint)
+      if(lsAction==LS_SerialPrint || lsAction==LS_SerialPrintLong)
       {
         char lfilename[13];
         SERIAL_PROTOCOLPGM("/");
@@ -113,10 +115,22 @@ void  CardReader::lsDive(SdFile &parent, SdFile** parents, uint8_t dirDepth)
             break;
           }
         }
-        SERIAL_PROTOCOLLN(filename);
+        if (lsAction==LS_SerialPrintLong && longFilename[0] != '\0')
+        {
+          SERIAL_PROTOCOL(filename);
+          SERIAL_PROTOCOLPGM(" ");
+          SERIAL_PROTOCOLLN(longFilename);
+        }
+        else
+        {
+          SERIAL_PROTOCOLLN(filename);
+        }
       }
       else if(lsAction==LS_Count)
       {
+#if SDCARD_INDEX_SIZE
+        addIndexEntry(entry, p, longFilename[0] != '\0' ? longFilename : filename);
+#endif
         nrFiles++;
       }
       else if(lsAction==LS_GetFilename)
@@ -129,9 +143,9 @@ void  CardReader::lsDive(SdFile &parent, SdFile** parents, uint8_t dirDepth)
   }
 }
 
-void CardReader::ls()
+void CardReader::ls(bool longNames)
 {
-  lsAction=LS_SerialPrint;
+  lsAction=longNames ? LS_SerialPrintLong : LS_SerialPrint;
   root.rewind();
   SdFile* lsParents[MAX_DIR_DEPTH] = {0};
   lsDive(root, lsParents, 0);
@@ -142,6 +156,7 @@ void CardReader::initsd()
 {
   // cardOK = false;
   state &= ~SD_OK;
+  invalidateIndex();
   if(root.isOpen())
     root.close();
 #ifdef SDSLOW
@@ -191,6 +206,7 @@ void CardReader::setroot()
   workDir=root;
   curDir=&workDir;
   workDirDepth = 0;
+  invalidateIndex();
 }
 
 void CardReader::release()
@@ -199,6 +215,7 @@ void CardReader::release()
 //  pause = false;
 //  cardOK = false;
   state &= ~(SD_PRINTING | SD_PAUSE | SD_OK);
+  invalidateIndex();
 }
 
 void CardReader::startFileprint()
@@ -218,6 +235,25 @@ void CardReader::openLogFile(const char* name)
   openFile(name, false);
 }
 
+// M28: the upload is closed by M29, so it can grow in preallocated contiguous runs
+void CardReader::openUploadFile(const char* name)
+{
+  openFile(name, false);
+  if (saving())
+    file.preallocate();
+}
+
+#ifdef PRINT_LOG
+// the print log is kept in the root folder, open for appending beside the printed file
+bool CardReader::openPrintLog(SdFile &log)
+{
+  if (!cardOK() || !log.open(&root, PRINT_LOG_FILENAME, O_CREAT | O_APPEND | O_WRITE))
+    return false;
+  invalidateIndex();
+  return true;
+}
+#endif
+
 void CardReader::openFile(const char* name,bool read)
 {
   if(!cardOK())
@@ -240,11 +276,12 @@ void CardReader::openFile(const char* name,bool read)
       dirname_end=strchr(dirname_start,'/');
       if(dirname_end>0 && dirname_end>dirname_start)
       {
-        char subdirname[13];
-        strncpy(subdirname, dirname_start, dirname_end-dirname_start);
-        subdirname[dirname_end-dirname_start]=0;
+        char subdirname[LONG_FILENAME_LENGTH];
+        uint8_t len = min(dirname_end-dirname_start, LONG_FILENAME_LENGTH-1);
+        strncpy(subdirname, dirname_start, len);
+        subdirname[len]=0;
         SERIAL_ECHOLN(subdirname);
-        if(!myDir.open(curDir,subdirname,O_READ))
+        if(!openByName(myDir, curDir, subdirname, O_READ))
         {
           SERIAL_PROTOCOLPGM(MSG_SD_OPEN_FILE_FAIL);
           SERIAL_PROTOCOL(subdirname);
@@ -268,8 +305,12 @@ void CardReader::openFile(const char* name,bool read)
   }
   if(read)
   {
-    if (file.open(curDir, fname, O_READ))
+    if (openByName(file, curDir, fname, O_READ))
     {
+#if SD_EXTENT_MAP_SIZE
+      // resolve the cluster chain now, so reading the file needs no FAT lookups
+      file.setExtentMap(&fileExtents);
+#endif
       filesize = file.fileSize();
       SERIAL_PROTOCOLPGM(MSG_SD_FILE_OPENED);
       SERIAL_PROTOCOL(fname);
@@ -299,6 +340,7 @@ void CardReader::openFile(const char* name,bool read)
     }
     else
     {
+      invalidateIndex();
       state |= SD_SAVING;
       SERIAL_PROTOCOLPGM(MSG_SD_WRITE_TO_FILE);
       SERIAL_PROTOCOLLN(name);
@@ -359,6 +401,7 @@ void CardReader::removeFile(const char* name)
   }
     if (file.remove(curDir, fname))
     {
+      invalidateIndex();
       SERIAL_PROTOCOLPGM("File deleted:");
       SERIAL_PROTOCOL(fname);
       sdpos = 0;
@@ -389,6 +432,42 @@ void CardReader::getStatus()
   }
 }
 
+void CardReader::printStats()
+{
+  SERIAL_PROTOCOLPGM("SD cache data hit:");
+  SERIAL_PROTOCOL(volume.cacheHits(SdVolume::CACHE_DATA));
+  SERIAL_PROTOCOLPGM(" miss:");
+  SERIAL_PROTOCOL(volume.cacheMisses(SdVolume::CACHE_DATA));
+  SERIAL_PROTOCOLPGM(" meta hit:");
+  SERIAL_PROTOCOL(volume.cacheHits(SdVolume::CACHE_META));
+  SERIAL_PROTOCOLPGM(" miss:");
+  SERIAL_PROTOCOL(volume.cacheMisses(SdVolume::CACHE_META));
+#if SD_EXTENT_MAP_SIZE
+  if (isFileOpen())
+  {
+    SERIAL_PROTOCOLPGM(" extents:");
+    SERIAL_PROTOCOL((int)fileExtents.count());
+    if (!fileExtents.complete())
+      SERIAL_PROTOCOLPGM("+");
+  }
+#endif
+  SERIAL_EOL;
+
+  const sd_stats_t& stats = card.stats();
+  SERIAL_PROTOCOLPGM("SD spi rate:");
+  SERIAL_PROTOCOL((int)card.sckRate());
+  SERIAL_PROTOCOLPGM(" blocks:");
+  SERIAL_PROTOCOL(stats.blocks);
+  SERIAL_PROTOCOLPGM(" crc:");
+  SERIAL_PROTOCOL(stats.crcErrors);
+  SERIAL_PROTOCOLPGM(" retries:");
+  SERIAL_PROTOCOL(stats.retries);
+  SERIAL_PROTOCOLPGM(" failed:");
+  SERIAL_PROTOCOL(stats.failures);
+  SERIAL_PROTOCOLPGM(" slowdowns:");
+  SERIAL_PROTOCOLLN(stats.slowDowns);
+}
+
 void CardReader::write_command(char *buf)
 {
   char* begin = buf;
@@ -498,24 +577,166 @@ void CardReader::closefile()
 
 void CardReader::getfilename(const uint8_t nr)
 {
+#if SDCARD_INDEX_SIZE
+  if (dirIndexFiles < 0)
+    getnrfilenames();
+#endif
   curDir=&workDir;
   lsAction=LS_GetFilename;
   nrFiles=nr;
+#if SDCARD_INDEX_SIZE
+  if (nr < dirIndexFiles)
+  {
+    // start at the closest indexed file and only skip the files in between
+    uint8_t slot = nr >> dirIndexShift;
+    nrFiles -= slot << dirIndexShift;
+    curDir->seekSet(uint32_t(dirIndexEntry[slot]) << 5);
+  }
+  else
+#endif
   curDir->rewind();
   lsDive(*curDir, NULL, 0);
 }
 
 uint16_t CardReader::getnrfilenames()
 {
+#if SDCARD_INDEX_SIZE
+  if (dirIndexFiles >= 0)
+    return dirIndexFiles;
+  dirIndexShift = 0;
+#endif
   curDir=&workDir;
   lsAction=LS_Count;
   nrFiles=0;
   curDir->rewind();
   lsDive(*curDir, NULL, 0);
   //SERIAL_ECHOLN(nrFiles);
+#if SDCARD_INDEX_SIZE
+#ifdef SDCARD_SORT_NEWEST_FIRST
+  if (dirIndexShift == 0)
+    sortIndex();
+#endif
+  dirIndexFiles = nrFiles;
+#endif
   return nrFiles;
 }
 
+#if SDCARD_INDEX_SIZE
+void CardReader::addIndexEntry(uint16_t entry, const dir_t &p, const char *name)
+{
+  if (nrFiles & ((1 << dirIndexShift) - 1))
+    return;
+  uint8_t slot = nrFiles >> dirIndexShift;
+  if (slot == SDCARD_INDEX_SIZE)
+  {
+    // table is full, keep every other entry and index half as many files from now on
+    for (uint8_t i = 1; i < SDCARD_INDEX_SIZE / 2; i++)
+    {
+      dirIndexEntry[i] = dirIndexEntry[i * 2];
+#ifdef SDCARD_LONG_NAME_OPEN
+      dirIndexHash[i] = dirIndexHash[i * 2];
+#endif
+    }
+    dirIndexShift++;
+    slot = SDCARD_INDEX_SIZE / 2;
+  }
+  dirIndexEntry[slot] = entry;
+#ifdef SDCARD_LONG_NAME_OPEN
+  dirIndexHash[slot] = nameHash(name);
+#endif
+#ifdef SDCARD_SORT_NEWEST_FIRST
+  dirIndexKey[slot] = DIR_IS_SUBDIR(&p) ? 0xFFFFFFFF : (uint32_t(p.lastWriteDate) << 16) | p.lastWriteTime;
+#endif
+}
+
+#ifdef SDCARD_SORT_NEWEST_FIRST
+void CardReader::sortIndex()
+{
+  // insertion sort, stable so files with the same date keep the directory order
+  for (uint8_t i = 1; i < nrFiles; i++)
+  {
+    uint16_t entry = dirIndexEntry[i];
+    uint32_t key = dirIndexKey[i];
+#ifdef SDCARD_LONG_NAME_OPEN
+    uint16_t hash = dirIndexHash[i];
+#endif
+    uint8_t j = i;
+    for (; j > 0 && dirIndexKey[j - 1] < key; j--)
+    {
+      dirIndexEntry[j] = dirIndexEntry[j - 1];
+      dirIndexKey[j] = dirIndexKey[j - 1];
+#ifdef SDCARD_LONG_NAME_OPEN
+      dirIndexHash[j] = dirIndexHash[j - 1];
+#endif
+    }
+    dirIndexEntry[j] = entry;
+    dirIndexKey[j] = key;
+#ifdef SDCARD_LONG_NAME_OPEN
+    dirIndexHash[j] = hash;
+#endif
+  }
+}
+#endif
+#endif
+
+bool CardReader::openByName(SdFile &f, SdFile *dir, const char *name, uint8_t oflag)
+{
+  if (f.open(dir, name, oflag))
+    return true;
+#ifdef SDCARD_LONG_NAME_OPEN
+  uint16_t index;
+  if (findLongName(dir, name, index))
+    return f.open(dir, index, oflag);
+#endif
+  return false;
+}
+
+#ifdef SDCARD_LONG_NAME_OPEN
+uint16_t CardReader::nameHash(const char *name)
+{
+  // case insensitive, like the 8.3 names
+  uint16_t hash = 0;
+  for (; *name; name++)
+    hash = hash * 31 + tolower(*name);
+  return hash;
+}
+
+bool CardReader::findLongName(SdFile *dir, const char *name, uint16_t &index)
+{
+  dir_t p;
+  char lfn[LONG_FILENAME_LENGTH];
+#if SDCARD_INDEX_SIZE
+  if (dir == &workDir && dirIndexFiles >= 0 && dirIndexShift == 0)
+  {
+    // every listed file of the working directory is in the index, only read the entries with a matching hash
+    uint16_t hash = nameHash(name);
+    for (uint8_t i = 0; i < dirIndexFiles; i++)
+    {
+      if (dirIndexHash[i] != hash)
+        continue;
+      dir->seekSet(uint32_t(dirIndexEntry[i]) << 5);
+      if (dir->readDir(&p, lfn) > 0 && strcasecmp(lfn, name) == 0)
+      {
+        index = (dir->curPosition() >> 5) - 1;
+        return true;
+      }
+    }
+    // files the browser does not list (not .g*) are not indexed, look for those below
+  }
+#endif
+  dir->rewind();
+  while (dir->readDir(&p, lfn) > 0)
+  {
+    if (lfn[0] != '\0' && strcasecmp(lfn, name) == 0)
+    {
+      index = (dir->curPosition() >> 5) - 1;
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
 void CardReader::chdir(const char * relpath)
 {
   SdFile newfile;
@@ -524,7 +745,7 @@ void CardReader::chdir(const char * relpath)
   if(workDir.isOpen())
     parent=&workDir;
 
-  if(!newfile.open(*parent,relpath, O_READ))
+  if(!openByName(newfile, parent, relpath, O_READ))
   {
    SERIAL_ECHO_START;
    SERIAL_ECHOPGM(MSG_SD_CANT_ENTER_SUBDIR);
@@ -538,6 +759,7 @@ void CardReader::chdir(const char * relpath)
       workDirParents[0]=*parent;
     }
     workDir=newfile;
+    invalidateIndex();
   }
 }
 
@@ -549,9 +771,30 @@ void CardReader::updir()
     workDir = workDirParents[0];
     for (uint8_t d = 0; d < workDirDepth; d++)
       workDirParents[d] = workDirParents[d+1];
+    invalidateIndex();
   }
 }
 
+#if defined(LOOP_TELEMETRY) || defined(EVENT_TRACE)
+int16_t CardReader::getTimed()
+{
+#ifdef EVENT_TRACE
+  trace_event(TRACE_SD_READ, 0);
+#endif
+#ifdef LOOP_TELEMETRY
+  unsigned long t = micros();
+#endif
+  int16_t c = file.read();
+#ifdef LOOP_TELEMETRY
+  telemetry_sd_read(micros() - t);
+#endif
+#ifdef EVENT_TRACE
+  trace_event(TRACE_SD_READ_END, 0);
+#endif
+  return c;
+}
+#endif
+
 void CardReader::printingHasFinished()
 {
     st_synchronize();
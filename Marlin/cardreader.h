@@ -17,6 +17,8 @@
 #endif
 
 #include "SdFile.h"
+#include "telemetry.h"
+#include "trace.h"
 
 #define SD_OK               1
 #define SD_SAVING           2
@@ -27,7 +29,7 @@
 #define SD_ISDIR           64
 #define SD_CHECKAUTOSTART 128
 
-enum LsAction {LS_SerialPrint,LS_Count,LS_GetFilename};
+enum LsAction {LS_SerialPrint,LS_SerialPrintLong,LS_Count,LS_GetFilename};
 
 class CardReader
 {
@@ -43,25 +45,36 @@ public:
   void checkautostart(bool force);
   void openFile(const char* name,bool read);
   void openLogFile(const char* name);
+  void openUploadFile(const char* name);
+#ifdef PRINT_LOG
+  bool openPrintLog(SdFile &log);
+#endif
   void removeFile(const char* name);
   void closefile();
   void release();
   void startFileprint();
   void getStatus();
+  void printStats();
+  FORCE_INLINE void resetStats() { volume.cacheResetStats(); card.clearStats(); }
   void printingHasFinished();
 
   void getfilename(const uint8_t nr);
   void getFilenameFromNr(char* buffer, uint8_t nr);
   uint16_t getnrfilenames();
 
-  void ls();
+  void ls(bool longNames = false);
   void chdir(const char * relpath);
   void updir();
   void setroot();
 
   FORCE_INLINE bool isFileOpen() { return file.isOpen(); }
   FORCE_INLINE bool eof() { return sdpos>=filesize ;}
+#if defined(LOOP_TELEMETRY) || defined(EVENT_TRACE)
+  // the first byte of each block may have to wait for the card, only those reads are timed
+  FORCE_INLINE int16_t get() {  sdpos = file.curPosition(); if ((sdpos & 0x1FF) == 0) return getTimed(); return (int16_t)file.read();}
+#else
   FORCE_INLINE int16_t get() {  sdpos = file.curPosition();return (int16_t)file.read();}
+#endif
   FORCE_INLINE int16_t fgets(char* str, int16_t num) { return file.fgets(str, num, NULL); }
   FORCE_INLINE void setIndex(long index) {sdpos = index;file.seekSet(index);}
   FORCE_INLINE uint8_t percentDone(){if(!isFileOpen()) return 0; if(filesize) return sdpos/((filesize+99)/100); else return 0;}
@@ -69,6 +82,7 @@ public:
   FORCE_INLINE bool atRoot() { return workDirDepth==0; }
   FORCE_INLINE uint32_t getFilePos() { return sdpos; }
   FORCE_INLINE uint32_t getFileSize() { return filesize; }
+  FORCE_INLINE uint32_t getFileCluster() const { return file.firstCluster(); }
   FORCE_INLINE bool isOk() { return cardOK() && card.errorCode() == 0; }
   FORCE_INLINE int errorCode() { return card.errorCode(); }
   FORCE_INLINE void clearError() { card.clearError(); }
@@ -109,6 +123,9 @@ public:
   FORCE_INLINE void resumePrinting() { state &= ~SD_PAUSE; }
 
 private:
+#if defined(LOOP_TELEMETRY) || defined(EVENT_TRACE)
+  int16_t getTimed();
+#endif
   char filename[13];
   char longFilename[LONG_FILENAME_LENGTH];
 
@@ -119,6 +136,9 @@ private:
   Sd2Card card;
   SdVolume volume;
   SdFile file;
+#if SD_EXTENT_MAP_SIZE
+  SdExtentMap fileExtents; //cluster chain of the file being printed
+#endif
   uint32_t filesize;
   unsigned long autostart_atmillis;
   uint32_t sdpos ;
@@ -127,6 +147,31 @@ private:
   int16_t nrFiles; //counter for the files in the current directory and recycled as position counter for getting the nrFiles'th name in the directory.
   char* diveDirName;
   void lsDive(SdFile &parent, SdFile** parents, uint8_t dirDepth);
+
+#if SDCARD_INDEX_SIZE
+  int16_t dirIndexFiles; //number of files in the indexed working directory, -1 when the index needs to be rebuilt.
+  uint8_t dirIndexShift; //every (1 << dirIndexShift)'th file has an index entry.
+  uint16_t dirIndexEntry[SDCARD_INDEX_SIZE]; //directory entry number (position / 32) where the indexed file starts, including its long filename.
+#ifdef SDCARD_LONG_NAME_OPEN
+  uint16_t dirIndexHash[SDCARD_INDEX_SIZE]; //nameHash() of the (long) filename of the indexed file.
+#endif
+#ifdef SDCARD_SORT_NEWEST_FIRST
+  uint32_t dirIndexKey[SDCARD_INDEX_SIZE]; //modification date and time of the indexed file, folders sort on top.
+  void sortIndex();
+#endif
+  void addIndexEntry(uint16_t entry, const dir_t &p, const char *name);
+#endif
+#ifdef SDCARD_LONG_NAME_OPEN
+  static uint16_t nameHash(const char *name);
+  bool findLongName(SdFile *dir, const char *name, uint16_t &index);
+#endif
+  bool openByName(SdFile &f, SdFile *dir, const char *name, uint8_t oflag);
+  FORCE_INLINE void invalidateIndex()
+  {
+#if SDCARD_INDEX_SIZE
+    dirIndexFiles = -1;
+#endif
+  }
 };
 extern CardReader card;
 #define IS_SD_PRINTING (card.sdprinting())
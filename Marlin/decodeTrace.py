@@ -0,0 +1,142 @@
+#!/usr/bin/python
+#
+# Converts the event trace of the firmware (EVENT_TRACE) into a Chrome trace
+"""Event Trace Decoder
+
+Reads the binary dumps of M48 from a serial capture, or the file written by the
+simulator with SIM_EVENT_TRACE, and writes them as a Chrome trace JSON file that
+can be opened in chrome://tracing or https://ui.perfetto.dev
+
+Several dumps in one capture are joined into one timeline.
+
+Usage: python decodeTrace.py [options] capture [output.json]
+
+Options:
+  -h, --help        show this help
+  --extruders=...   the number of extruders of the firmware, the heater after them is the bed (default: 2)
+"""
+
+from __future__ import print_function
+import sys
+import getopt
+import json
+import struct
+
+# event types, see trace.h
+TRACE_BLOCK_START = 1
+TRACE_BLOCK_END = 2
+TRACE_PLAN_BUFFER = 3
+TRACE_SD_READ = 4
+TRACE_SD_READ_END = 5
+TRACE_HEATER = 8
+
+THREADS = {1: "stepper ISR", 2: "planner", 3: "SD card", 4: "heaters"}
+
+def readEvents(data):
+    "Find the TRACE:<count> <size> headers and return the events as (time, type, arg)"
+    events = []
+    pos = 0
+    while True:
+        pos = data.find(b"TRACE:", pos)
+        if pos < 0:
+            break
+        end = data.find(b"\n", pos)
+        if end < 0:
+            break
+        count, size = [int(n) for n in data[pos + 6:end].strip().split()]
+        pos = end + 1
+        if len(data) < pos + count * size:
+            print("Dump at %d is cut short, %d of %d events" % (pos, (len(data) - pos) // size, count), file=sys.stderr)
+            count = (len(data) - pos) // size
+        for n in range(count):
+            events.append(struct.unpack_from("<IBB", data, pos + n * size))
+        pos += count * size
+    return events
+
+def unwrap(events):
+    "micros() wraps after 71 minutes, make the times continuous"
+    offset = 0
+    last = None
+    result = []
+    for time, type, arg in events:
+        if last is not None and time < last and last - time > 0x80000000:
+            offset += 0x100000000
+        last = time
+        result.append((time + offset, type, arg))
+    return result
+
+def convert(events, extruders):
+    trace = []
+    for tid, name in THREADS.items():
+        trace.append({"ph": "M", "name": "thread_name", "pid": 1, "tid": tid, "args": {"name": name}})
+    openBlock = None
+    sdRead = False
+    for time, type, arg in events:
+        if type == TRACE_BLOCK_START:
+            # a block that waits for an extruder change is taken twice
+            if openBlock is None:
+                trace.append({"ph": "B", "name": "block %d" % (arg), "pid": 1, "tid": 1, "ts": time, "args": {"index": arg}})
+                openBlock = arg
+        elif type == TRACE_BLOCK_END:
+            # the start can be overwritten in the ring buffer
+            if openBlock is not None:
+                trace.append({"ph": "E", "pid": 1, "tid": 1, "ts": time})
+                openBlock = None
+        elif type == TRACE_PLAN_BUFFER:
+            trace.append({"ph": "i", "s": "t", "name": "plan_buffer_line", "pid": 1, "tid": 2, "ts": time})
+            trace.append({"ph": "C", "name": "planned blocks", "pid": 1, "tid": 2, "ts": time, "args": {"blocks": arg}})
+        elif type == TRACE_SD_READ:
+            trace.append({"ph": "B", "name": "SD read", "pid": 1, "tid": 3, "ts": time})
+            sdRead = True
+        elif type == TRACE_SD_READ_END:
+            if sdRead:
+                trace.append({"ph": "E", "pid": 1, "tid": 3, "ts": time})
+                sdRead = False
+        elif type >= TRACE_HEATER:
+            heater = type - TRACE_HEATER
+            name = "bed PWM" if heater == extruders else "heater %d PWM" % (heater)
+            trace.append({"ph": "C", "name": name, "pid": 1, "tid": 4, "ts": time, "args": {"pwm": arg}})
+        else:
+            print("Unknown event type %d at %d us" % (type, time), file=sys.stderr)
+    return {"traceEvents": trace, "displayTimeUnit": "ms"}
+
+def main(argv):
+    "Default values"
+    extruders = 2
+
+    try:
+        opts, args = getopt.getopt(argv, "h", ["help", "extruders="])
+    except getopt.GetoptError:
+        usage()
+        sys.exit(2)
+
+    for opt, arg in opts:
+        if opt in ("-h", "--help"):
+            usage()
+            sys.exit()
+        elif opt == "--extruders":
+            extruders = int(arg)
+
+    if len(args) < 1 or len(args) > 2:
+        usage()
+        sys.exit(2)
+
+    with open(args[0], "rb") as f:
+        events = unwrap(readEvents(f.read()))
+    if not events:
+        print("No trace found in %s" % (args[0]), file=sys.stderr)
+        sys.exit(1)
+
+    result = json.dumps(convert(events, extruders))
+    if len(args) > 1:
+        with open(args[1], "w") as f:
+            f.write(result)
+    else:
+        print(result)
+    print("%d events, %.3f s" % (len(events), (events[-1][0] - events[0][0]) / 1000000.0), file=sys.stderr)
+
+def usage():
+    print(__doc__)
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
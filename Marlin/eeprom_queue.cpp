@@ -0,0 +1,122 @@
+#include "Marlin.h"
+
+#if defined(EEPROM_WRITE_QUEUE) && defined(__AVR__)
+
+#define EEPROM_QUEUE_MASK (EEPROM_QUEUE_SIZE - 1)
+
+struct eeprom_write_t {
+  uint16_t addr;
+  uint8_t value;
+};
+
+static eeprom_write_t eeprom_queue[EEPROM_QUEUE_SIZE];
+static volatile uint8_t eeprom_queue_head;
+static volatile uint8_t eeprom_queue_tail;
+
+// Start the next write that changes the EEPROM, bytes that already hold their value are dropped.
+ISR(EE_READY_vect)
+{
+  while (eeprom_queue_tail != eeprom_queue_head)
+  {
+    const eeprom_write_t &w = eeprom_queue[eeprom_queue_tail];
+    eeprom_queue_tail = (eeprom_queue_tail + 1) & EEPROM_QUEUE_MASK;
+    EEAR = w.addr;
+    EECR |= _BV(EERE);
+    if (EEDR != w.value)
+    {
+      EEDR = w.value;
+      // EEPE has to follow EEMPE within 4 cycles
+      EECR |= _BV(EEMPE);
+      EECR |= _BV(EEPE);
+      return;
+    }
+  }
+  // the interrupt fires as long as the EEPROM is ready, so it is only enabled while there is work
+  EECR &= ~_BV(EERIE);
+}
+
+static void eeprom_queue_byte(uint16_t addr, uint8_t value)
+{
+  for (;;)
+  {
+    CRITICAL_SECTION_START;
+    if (eeprom_queue_tail == eeprom_queue_head && !(EECR & _BV(EEPE)))
+    {
+      // nothing pending, a read is immediate and saves a queue entry for unchanged bytes
+      EEAR = addr;
+      EECR |= _BV(EERE);
+      if (EEDR == value)
+      {
+        CRITICAL_SECTION_END;
+        return;
+      }
+    }
+    uint8_t next = (eeprom_queue_head + 1) & EEPROM_QUEUE_MASK;
+    if (next != eeprom_queue_tail)
+    {
+      eeprom_queue[eeprom_queue_head].addr = addr;
+      eeprom_queue[eeprom_queue_head].value = value;
+      eeprom_queue_head = next;
+      EECR |= _BV(EERIE);
+      CRITICAL_SECTION_END;
+      return;
+    }
+    CRITICAL_SECTION_END;
+    // full, the interrupt frees an entry within 3.3 ms, unless the caller disabled interrupts
+    if (!(SREG & _BV(SREG_I)))
+      eeprom_queue_flush();
+  }
+}
+
+void eeprom_queue_write(void *dst, const void *src, size_t n)
+{
+  uint16_t addr = (uint16_t)dst;
+  const uint8_t *s = (const uint8_t *)src;
+  while (n--)
+    eeprom_queue_byte(addr++, *s++);
+}
+
+void eeprom_queue_read(void *dst, const void *src, size_t n)
+{
+  // a read waits for the write in progress, the queue must not start another one meanwhile
+  {
+    CRITICAL_SECTION_START;
+    EECR &= ~_BV(EERIE);
+    CRITICAL_SECTION_END;
+  }
+  (eeprom_read_block)(dst, src, n);
+
+  // the queued bytes are newer than the EEPROM, later entries win
+  uint16_t start = (uint16_t)src;
+  CRITICAL_SECTION_START;
+  for (uint8_t i = eeprom_queue_tail; i != eeprom_queue_head; i = (i + 1) & EEPROM_QUEUE_MASK)
+  {
+    uint16_t offset = eeprom_queue[i].addr - start;
+    if (offset < n)
+      ((uint8_t *)dst)[offset] = eeprom_queue[i].value;
+  }
+  if (eeprom_queue_tail != eeprom_queue_head)
+    EECR |= _BV(EERIE);
+  CRITICAL_SECTION_END;
+}
+
+bool eeprom_queue_idle()
+{
+  return eeprom_queue_tail == eeprom_queue_head && !(EECR & _BV(EEPE));
+}
+
+void eeprom_queue_flush()
+{
+  CRITICAL_SECTION_START;
+  EECR &= ~_BV(EERIE);
+  while (eeprom_queue_tail != eeprom_queue_head)
+  {
+    const eeprom_write_t &w = eeprom_queue[eeprom_queue_tail];
+    (eeprom_update_byte)((uint8_t *)w.addr, w.value);
+    eeprom_queue_tail = (eeprom_queue_tail + 1) & EEPROM_QUEUE_MASK;
+  }
+  while (EECR & _BV(EEPE)) {}
+  CRITICAL_SECTION_END;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef EEPROM_QUEUE_H
+#define EEPROM_QUEUE_H
+
+#include <avr/eeprom.h>
+#include "Configuration.h"
+
+#if defined(EEPROM_WRITE_QUEUE) && defined(__AVR__)
+
+// Writes are queued and done from the EEPROM ready interrupt, a byte that already holds the value is skipped.
+// The writer only waits when the queue is full. Reads see the queued bytes, so the EEPROM behaves as if written.
+void eeprom_queue_write(void *dst, const void *src, size_t n);
+void eeprom_queue_read(void *dst, const void *src, size_t n);
+// true when nothing is queued or being written
+bool eeprom_queue_idle();
+// Write everything that is queued and wait until done, also with interrupts disabled. For kill() and restarts.
+void eeprom_queue_flush();
+
+static inline uint8_t eeprom_queued_read_byte(const uint8_t *p) { uint8_t v; eeprom_queue_read(&v, p, sizeof(v)); return v; }
+static inline uint16_t eeprom_queued_read_word(const uint16_t *p) { uint16_t v; eeprom_queue_read(&v, p, sizeof(v)); return v; }
+static inline uint32_t eeprom_queued_read_dword(const uint32_t *p) { uint32_t v; eeprom_queue_read(&v, p, sizeof(v)); return v; }
+static inline float eeprom_queued_read_float(const float *p) { float v; eeprom_queue_read(&v, p, sizeof(v)); return v; }
+static inline void eeprom_queued_write_byte(uint8_t *p, uint8_t v) { eeprom_queue_write(p, &v, sizeof(v)); }
+static inline void eeprom_queued_write_word(uint16_t *p, uint16_t v) { eeprom_queue_write(p, &v, sizeof(v)); }
+static inline void eeprom_queued_write_dword(uint32_t *p, uint32_t v) { eeprom_queue_write(p, &v, sizeof(v)); }
+static inline void eeprom_queued_write_float(float *p, float v) { eeprom_queue_write(p, &v, sizeof(v)); }
+
+// All EEPROM access has to go through the queue, or the interrupt could start a write in the middle of it.
+// (eeprom_write_byte)(...) still calls avr-libc.
+#define eeprom_read_byte(p)          eeprom_queued_read_byte(p)
+#define eeprom_read_word(p)          eeprom_queued_read_word(p)
+#define eeprom_read_dword(p)         eeprom_queued_read_dword(p)
+#define eeprom_read_float(p)         eeprom_queued_read_float(p)
+#define eeprom_read_block(dst, src, n)  eeprom_queue_read(dst, src, n)
+#define eeprom_write_byte(p, v)      eeprom_queued_write_byte(p, v)
+#define eeprom_write_word(p, v)      eeprom_queued_write_word(p, v)
+#define eeprom_write_dword(p, v)     eeprom_queued_write_dword(p, v)
+#define eeprom_write_float(p, v)     eeprom_queued_write_float(p, v)
+#define eeprom_write_block(src, dst, n) eeprom_queue_write(dst, src, n)
+#define eeprom_update_byte(p, v)     eeprom_queued_write_byte(p, v)
+#define eeprom_update_word(p, v)     eeprom_queued_write_word(p, v)
+#define eeprom_update_dword(p, v)    eeprom_queued_write_dword(p, v)
+#define eeprom_update_float(p, v)    eeprom_queued_write_float(p, v)
+#define eeprom_update_block(src, dst, n) eeprom_queue_write(dst, src, n)
+#undef eeprom_is_ready
+#define eeprom_is_ready()            eeprom_queue_idle()
+
+#else
+
+static inline void eeprom_queue_flush() {}
+
+#endif
+#endif //EEPROM_QUEUE_H
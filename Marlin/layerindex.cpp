@@ -0,0 +1,71 @@
+#include "layerindex.h"
+#include "cardreader.h"
+
+#if defined(SDSUPPORT) && LAYER_INDEX_SIZE
+
+static layer_entry_t layers[LAYER_INDEX_SIZE];
+static uint8_t layer_count = 0;     // used entries
+static uint8_t layer_shift = 0;     // every (1 << layer_shift)'th layer has an entry
+static uint16_t layer_nr = 0;       // layers seen since the index was cleared
+static float layer_top = 0.0f;      // highest layer seen so far
+static uint32_t layer_file_cluster = 0;
+static uint32_t layer_file_size = 0;
+
+void layer_index_clear()
+{
+  layer_count = 0;
+  layer_shift = 0;
+  layer_nr = 0;
+  layer_top = 0.0f;
+  layer_file_cluster = card.getFileCluster();
+  layer_file_size = card.getFileSize();
+}
+
+bool layer_index_is_new(float z, uint32_t filepos)
+{
+  if ((card.getFileCluster() != layer_file_cluster) || (card.getFileSize() != layer_file_size))
+    layer_index_clear();
+  // a z-hop also raises the top, the layers below it are skipped until the print climbs past it
+  if (z <= layer_top + 0.001f)
+    return false;
+  // printing the same file again, or continuing a recovered print, finds the layers already indexed
+  if (layer_count && (filepos <= layers[layer_count-1].filepos))
+    return false;
+  layer_top = z;
+  return true;
+}
+
+void layer_index_add(const layer_entry_t &entry)
+{
+  if (layer_nr++ & ((1 << layer_shift) - 1))
+    return;
+  if (layer_count == LAYER_INDEX_SIZE)
+  {
+    // table is full, keep every other entry and index half as many layers from now on
+    for (uint8_t i = 1; i < LAYER_INDEX_SIZE / 2; ++i)
+      layers[i] = layers[i * 2];
+    layer_count = LAYER_INDEX_SIZE / 2;
+    ++layer_shift;
+  }
+  layers[layer_count++] = entry;
+}
+
+bool layer_index_find(float z, layer_entry_t &entry)
+{
+  if ((card.getFileCluster() != layer_file_cluster) || (card.getFileSize() != layer_file_size))
+    return false;
+  // the recovery starts at the first extruding move at or above z, so nothing before the
+  // returned layer may reach that height
+  float limit = (z - 0.02f) * 100.0f;
+  for (uint8_t i = layer_count; i--; )
+  {
+    if (layers[i].z < limit)
+    {
+      entry = layers[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef LAYERINDEX_H
+#define LAYERINDEX_H
+
+#include "Marlin.h"
+
+#if defined(SDSUPPORT) && LAYER_INDEX_SIZE
+
+// Where a layer starts in the printed file, and the modal state needed to continue printing from there
+typedef struct
+{
+  uint32_t filepos;                 // start of the command that moves up to the layer
+  float e;                          // extruder position before that command
+  uint16_t z;                       // layer height in 1/100 mm
+  uint16_t feedrate;                // mm/min
+  uint8_t fan;
+  uint8_t relative;                 // axis_relative_state
+  uint16_t temperature[EXTRUDERS];  // hotend targets
+} layer_entry_t;
+
+// true when a move to height z by the command at filepos starts a layer that is not indexed yet
+bool layer_index_is_new(float z, uint32_t filepos);
+void layer_index_add(const layer_entry_t &entry);
+// find the last indexed layer that is printed completely below height z
+bool layer_index_find(float z, layer_entry_t &entry);
+void layer_index_clear();
+
+#endif
+#endif //LAYERINDEX_H
@@ -0,0 +1,71 @@
+#include "Marlin.h"
+#include "memory_stats.h"
+
+#ifdef __AVR__
+
+#define STACK_PAINT 0xC5
+
+extern "C" {
+  extern uint8_t __data_start;
+  extern uint8_t __heap_start;
+  extern void *__brkval;
+}
+
+// Runs from the startup code after the stack pointer is set and before the constructors. There is no stack frame, so
+// everything up to the stack pointer can be painted.
+void stack_paint() __attribute__((naked, used, section(".init3")));
+void stack_paint()
+{
+  uint8_t *p = &__heap_start;
+  while (p < (uint8_t *)SP)
+    *p++ = STACK_PAINT;
+}
+
+static uint8_t *heap_end()
+{
+  return __brkval ? (uint8_t *)__brkval : &__heap_start;
+}
+
+uint16_t ram_static_size()
+{
+  return &__heap_start - &__data_start;
+}
+
+uint16_t ram_heap_size()
+{
+  return heap_end() - &__heap_start;
+}
+
+uint16_t stack_free_min()
+{
+  // the heap overwrites the paint as it grows, so count from its current end
+  const uint8_t *p = heap_end();
+  const uint8_t *sp = (const uint8_t *)SP;
+  uint16_t count = 0;
+  while (p < sp && *p == STACK_PAINT)
+  {
+    ++p;
+    ++count;
+  }
+  return count;
+}
+
+#else
+
+uint16_t ram_static_size() { return 0; }
+uint16_t ram_heap_size() { return 0; }
+uint16_t stack_free_min() { return 0; }
+
+#endif
+
+void memory_print_stats()
+{
+  SERIAL_PROTOCOLPGM("RAM static:");
+  SERIAL_PROTOCOL(ram_static_size());
+  SERIAL_PROTOCOLPGM(" heap:");
+  SERIAL_PROTOCOL(ram_heap_size());
+  SERIAL_PROTOCOLPGM(" free:");
+  SERIAL_PROTOCOL(freeMemory());
+  SERIAL_PROTOCOLPGM(" min free:");
+  SERIAL_PROTOCOLLN(stack_free_min());
+}
@@ -0,0 +1,18 @@
+#ifndef MEMORY_STATS_H
+#define MEMORY_STATS_H
+
+#include <stdint.h>
+
+// The RAM between the heap and the stack is painted at boot, the painted bytes that are left show how deep the stack
+// has ever been. All sizes are in bytes, the simulator has no AVR memory layout and reports 0.
+
+// .data and .bss, everything allocated at build time ("make ramsize" lists the largest objects)
+uint16_t ram_static_size();
+// allocated with malloc/new
+uint16_t ram_heap_size();
+// the lowest free RAM between the heap and the stack seen since boot
+uint16_t stack_free_min();
+// M49: "RAM static:<bytes> heap:<bytes> free:<bytes> min free:<bytes>"
+void memory_print_stats();
+
+#endif //MEMORY_STATS_H
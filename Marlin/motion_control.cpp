@@ -23,8 +23,54 @@
 #include "stepper.h"
 #include "planner.h"
 
+// Fixed point format of the radius vector during arc generation: 1/65536 mm per LSB
+#define ARC_FIXED_ONE   65536.0f
+// Rotation matrix coefficients are stored as Q2.30
+#define ARC_COEFF_ONE   1073741824.0f
+
+// Signed multiply of a fixed point radius with a Q2.30 coefficient: (a * b) >> 30
+// Built from 16x16 bit partial products, which the AVR handles with its hardware multiplier,
+// instead of a generic 64 bit multiplication. |a| must stay below 2^30 (16m in 1/65536 mm units).
+static FORCE_INLINE int32_t mul_q30(int32_t a, int32_t b)
+{
+  int16_t  ah = a >> 16;
+  uint16_t al = a & 0xFFFF;
+  int16_t  bh = b >> 16;
+  uint16_t bl = b & 0xFFFF;
+
+  int32_t result = ((int32_t)ah * bh) << 2;
+  result += ((int32_t)ah * bl) >> 14;
+  result += ((int32_t)bh * al) >> 14;
+  result += ((uint32_t)al * bl) >> 30;
+  return result;
+}
+
+// Calculate the segment length of an arc with the given radius and feedrate (mm/s).
+// The chord error of a segment with length l is r - sqrt(r^2 - (l/2)^2), so the longest segment
+// within ARC_TOLERANCE_MM is l = 2 * sqrt(tol * (2r - tol)). Fast arcs use longer segments,
+// each segment should take at least minsegmenttime to keep the planner filled.
+static float arc_segment_length(float radius, float feed_rate)
+{
+  float mm_per_segment;
+  if (radius > ARC_TOLERANCE_MM)
+  {
+    mm_per_segment = 2 * sqrt(ARC_TOLERANCE_MM * (2 * radius - ARC_TOLERANCE_MM));
+  }
+  else
+  {
+    mm_per_segment = MAX_ARC_SEGMENT_MM;
+  }
+
+  float min_mm = feed_rate * (minsegmenttime / 1000000.0f);
+  if (mm_per_segment < min_mm) { mm_per_segment = min_mm; }
+
+  if (mm_per_segment < MIN_ARC_SEGMENT_MM) { mm_per_segment = MIN_ARC_SEGMENT_MM; }
+  if (mm_per_segment > MAX_ARC_SEGMENT_MM) { mm_per_segment = MAX_ARC_SEGMENT_MM; }
+  return mm_per_segment;
+}
+
 // The arc is approximated by generating a huge number of tiny, linear segments. The length of each
-// segment is configured in settings.mm_per_arc_segment.
+// segment is calculated by arc_segment_length() from the arc radius and feedrate.
 void mc_arc(float *position, float *target, float *offset, uint8_t axis_0, uint8_t axis_1,
   uint8_t axis_linear, float feed_rate, float radius, uint8_t isclockwise, uint8_t extruder)
 {
@@ -46,7 +92,8 @@ void mc_arc(float *position, float *target, float *offset, uint8_t axis_0, uint8
 
   float millimeters_of_travel = hypot(angular_travel*radius, fabs(linear_travel));
   if (millimeters_of_travel < 0.001) { return; }
-  uint16_t segments = floor(millimeters_of_travel/MM_PER_ARC_SEGMENT);
+  float segments_f = floor(millimeters_of_travel/arc_segment_length(radius, feed_rate));
+  uint16_t segments = (segments_f > 65535.0f) ? 65535 : (uint16_t)segments_f;
   if(segments == 0) segments = 1;
 
   /*
@@ -67,17 +114,18 @@ void mc_arc(float *position, float *target, float *offset, uint8_t axis_0, uint8
      For arc generation, the center of the circle is the axis of rotation and the radius vector is
      defined from the circle center to the initial position. Each line segment is formed by successive
      vector rotations. This requires only two cos() and sin() computations to form the rotation
-     matrix for the duration of the entire arc. Error may accumulate from numerical round-off, since
-     all double numbers are single precision on the Arduino. (True double precision will not have
-     round off issues for CNC applications.) Single precision error can accumulate to be greater than
-     tool precision in some cases. Therefore, arc path correction is implemented.
+     matrix for the duration of the entire arc.
 
-     Small angle approximation may be used to reduce computation overhead further. This approximation
-     holds for everything, but very small circles and large mm_per_arc_segment values. In other words,
+     The rotation itself runs in fixed point: the radius vector is kept in 1/65536 mm units and the
+     matrix coefficients in Q2.30, so every segment costs four integer multiplications (see mul_q30)
+     instead of four float multiplications. Error may accumulate from round-off of the coefficients
+     and truncation of the products. Therefore, arc path correction is implemented: every
+     N_ARC_CORRECTION segments the exact location is computed from the initial radius vector.
+
+     Small angle approximation (up to the third order term of sin) is used to form the rotation matrix.
+     This holds for everything, but very small circles with large segments. In other words,
      theta_per_segment would need to be greater than 0.1 rad and N_ARC_CORRECTION would need to be large
-     to cause an appreciable drift error. N_ARC_CORRECTION~=25 is more than small enough to correct for
-     numerical drift error. N_ARC_CORRECTION may be on the order a hundred(s) before error becomes an
-     issue for CNC machines with the single precision Arduino calculations.
+     to cause an appreciable drift error.
 
      This approximation also allows mc_arc to immediately insert a line segment into the planner
      without the initial overhead of computing cos() or sin(). By the time the arc needs to be applied
@@ -85,13 +133,17 @@ void mc_arc(float *position, float *target, float *offset, uint8_t axis_0, uint8
      This is important when there are successive arc motions.
   */
   // Vector rotation matrix values
-  float cos_T = 1-0.5*theta_per_segment*theta_per_segment; // Small angle approximation
-  float sin_T = theta_per_segment;
+  float sq_theta = theta_per_segment*theta_per_segment;
+  int32_t cos_T = lround((1-0.5*sq_theta) * ARC_COEFF_ONE);
+  int32_t sin_T = lround((theta_per_segment - sq_theta*theta_per_segment/6) * ARC_COEFF_ONE);
+
+  int32_t fr_axis0 = lround(r_axis0 * ARC_FIXED_ONE);
+  int32_t fr_axis1 = lround(r_axis1 * ARC_FIXED_ONE);
+  int32_t fr_axisi;
 
   float arc_target[4];
   float sin_Ti;
   float cos_Ti;
-  float r_axisi;
   uint16_t i;
   int8_t count = 0;
 
@@ -105,23 +157,23 @@ void mc_arc(float *position, float *target, float *offset, uint8_t axis_0, uint8
 
     if (count < N_ARC_CORRECTION) {
       // Apply vector rotation matrix
-      r_axisi = r_axis0*sin_T + r_axis1*cos_T;
-      r_axis0 = r_axis0*cos_T - r_axis1*sin_T;
-      r_axis1 = r_axisi;
+      fr_axisi = mul_q30(fr_axis0, sin_T) + mul_q30(fr_axis1, cos_T);
+      fr_axis0 = mul_q30(fr_axis0, cos_T) - mul_q30(fr_axis1, sin_T);
+      fr_axis1 = fr_axisi;
       count++;
     } else {
       // Arc correction to radius vector. Computed only every N_ARC_CORRECTION increments.
       // Compute exact location by applying transformation matrix from initial radius vector(=-offset).
       cos_Ti = cos(i*theta_per_segment);
       sin_Ti = sin(i*theta_per_segment);
-      r_axis0 = -offset[axis_0]*cos_Ti + offset[axis_1]*sin_Ti;
-      r_axis1 = -offset[axis_0]*sin_Ti - offset[axis_1]*cos_Ti;
+      fr_axis0 = lround((-offset[axis_0]*cos_Ti + offset[axis_1]*sin_Ti) * ARC_FIXED_ONE);
+      fr_axis1 = lround((-offset[axis_0]*sin_Ti - offset[axis_1]*cos_Ti) * ARC_FIXED_ONE);
       count = 0;
     }
 
     // Update arc_target location
-    arc_target[axis_0] = center_axis0 + r_axis0;
-    arc_target[axis_1] = center_axis1 + r_axis1;
+    arc_target[axis_0] = center_axis0 + fr_axis0 / ARC_FIXED_ONE;
+    arc_target[axis_1] = center_axis1 + fr_axis1 / ARC_FIXED_ONE;
     arc_target[axis_linear] += linear_per_segment;
     arc_target[E_AXIS] += extruder_per_segment;
 
@@ -140,3 +192,139 @@ void mc_arc(float *position, float *target, float *offset, uint8_t axis_0, uint8
   //   plan_set_acceleration_manager_enabled(acceleration_manager_was_enabled);
 }
 
+
+#ifdef BEZIER_CURVE_SUPPORT
+// Number of chords used to estimate the curve length for the Z and E distribution
+#define BEZIER_LENGTH_SAMPLES 16
+
+static float eval_bezier(float a, float b, float c, float d, float t)
+{
+  float s = 1.0f - t;
+  return s*s*s*a + 3*s*s*t*b + 3*s*t*t*c + t*t*t*d;
+}
+
+static FORCE_INLINE float dist_manhattan(float x0, float y0, float x1, float y1)
+{
+  return fabs(x0 - x1) + fabs(y0 - y1);
+}
+
+// The curve is flattened incrementally: only the next end point is calculated, and it is passed to the
+// planner right away. plan_buffer_line() waits while the block buffer is full, so new segments are
+// generated at the rate the stepper consumes them and no point list is kept in memory.
+// The parameter step is adapted to the curvature: it is halved as long as the midpoint of the chord is
+// further than BEZIER_TOLERANCE_MM from the curve, and doubled while a longer chord would still fit.
+void mc_bezier(float *position, float *target, float *offset, float feed_rate, uint8_t extruder)
+{
+  // Absolute control points
+  float first0 = position[X_AXIS] + offset[0];
+  float first1 = position[Y_AXIS] + offset[1];
+  float second0 = target[X_AXIS] + offset[2];
+  float second1 = target[Y_AXIS] + offset[3];
+
+  // Estimate the curve length, Z and E are distributed by length and not by the curve parameter
+  float total_length = 0.0f;
+  float last0 = position[X_AXIS];
+  float last1 = position[Y_AXIS];
+  for (uint8_t n = 1; n <= BEZIER_LENGTH_SAMPLES; ++n)
+  {
+    float t = float(n) / BEZIER_LENGTH_SAMPLES;
+    float p0 = eval_bezier(position[X_AXIS], first0, second0, target[X_AXIS], t);
+    float p1 = eval_bezier(position[Y_AXIS], first1, second1, target[Y_AXIS], t);
+    total_length += hypot(p0 - last0, p1 - last1);
+    last0 = p0;
+    last1 = p1;
+  }
+  if (total_length < 0.001f)
+  {
+    if (printing_state != PRINT_STATE_RECOVER)
+    {
+      plan_buffer_line(target[X_AXIS], target[Y_AXIS], target[Z_AXIS], target[E_AXIS], feed_rate, extruder);
+    }
+    return;
+  }
+
+  float z_per_mm = (target[Z_AXIS] - position[Z_AXIS]) / total_length;
+  float e_per_mm = (target[E_AXIS] - position[E_AXIS]) / total_length;
+
+  float bez_target[4];
+  bez_target[X_AXIS] = position[X_AXIS];
+  bez_target[Y_AXIS] = position[Y_AXIS];
+  bez_target[Z_AXIS] = position[Z_AXIS];
+  bez_target[E_AXIS] = position[E_AXIS];
+  float length_done = 0.0f;
+
+  float step = BEZIER_MAX_STEP;
+  float t = 0.0f;
+  while (t < 1.0f)
+  {
+    // First try to reduce the step until the chord is close enough to the curve
+    bool did_reduce = false;
+    float new_t = t + step;
+    if (new_t > 1.0f) new_t = 1.0f;
+    float new_pos0 = eval_bezier(position[X_AXIS], first0, second0, target[X_AXIS], new_t);
+    float new_pos1 = eval_bezier(position[Y_AXIS], first1, second1, target[Y_AXIS], new_t);
+    while (new_t - t >= BEZIER_MIN_STEP)
+    {
+      float candidate_t = 0.5f * (t + new_t);
+      float candidate_pos0 = eval_bezier(position[X_AXIS], first0, second0, target[X_AXIS], candidate_t);
+      float candidate_pos1 = eval_bezier(position[Y_AXIS], first1, second1, target[Y_AXIS], candidate_t);
+      float interp_pos0 = 0.5f * (bez_target[X_AXIS] + new_pos0);
+      float interp_pos1 = 0.5f * (bez_target[Y_AXIS] + new_pos1);
+      if (dist_manhattan(interp_pos0, interp_pos1, candidate_pos0, candidate_pos1) <= BEZIER_TOLERANCE_MM)
+        break;
+      new_t = candidate_t;
+      new_pos0 = candidate_pos0;
+      new_pos1 = candidate_pos1;
+      did_reduce = true;
+    }
+
+    // If the step was not reduced, try to enlarge it for flat parts of the curve
+    if (!did_reduce)
+    {
+      while (new_t - t <= BEZIER_MAX_STEP)
+      {
+        float candidate_t = t + 2 * (new_t - t);
+        if (candidate_t >= 1.0f)
+          break;
+        float candidate_pos0 = eval_bezier(position[X_AXIS], first0, second0, target[X_AXIS], candidate_t);
+        float candidate_pos1 = eval_bezier(position[Y_AXIS], first1, second1, target[Y_AXIS], candidate_t);
+        float interp_pos0 = 0.5f * (bez_target[X_AXIS] + candidate_pos0);
+        float interp_pos1 = 0.5f * (bez_target[Y_AXIS] + candidate_pos1);
+        if (dist_manhattan(interp_pos0, interp_pos1, new_pos0, new_pos1) > BEZIER_TOLERANCE_MM)
+          break;
+        new_t = candidate_t;
+        new_pos0 = candidate_pos0;
+        new_pos1 = candidate_pos1;
+      }
+    }
+
+    step = new_t - t;
+    t = new_t;
+
+    if (t >= 1.0f)
+    {
+      // Ensure last segment arrives at target location.
+      bez_target[X_AXIS] = target[X_AXIS];
+      bez_target[Y_AXIS] = target[Y_AXIS];
+      bez_target[Z_AXIS] = target[Z_AXIS];
+      bez_target[E_AXIS] = target[E_AXIS];
+    }
+    else
+    {
+      length_done += hypot(new_pos0 - bez_target[X_AXIS], new_pos1 - bez_target[Y_AXIS]);
+      // the length estimate is a lower bound, never overshoot Z and E before the end of the curve
+      float length_used = (length_done < total_length) ? length_done : total_length;
+      bez_target[X_AXIS] = new_pos0;
+      bez_target[Y_AXIS] = new_pos1;
+      bez_target[Z_AXIS] = position[Z_AXIS] + length_used * z_per_mm;
+      bez_target[E_AXIS] = position[E_AXIS] + length_used * e_per_mm;
+    }
+
+    clamp_to_software_endstops(bez_target);
+    if (printing_state != PRINT_STATE_RECOVER)
+    {
+      plan_buffer_line(bez_target[X_AXIS], bez_target[Y_AXIS], bez_target[Z_AXIS], bez_target[E_AXIS], feed_rate, extruder);
+    }
+  }
+}
+#endif // BEZIER_CURVE_SUPPORT
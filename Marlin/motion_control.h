@@ -29,4 +29,11 @@
 void mc_arc(float *position, float *target, float *offset, unsigned char axis_0, unsigned char axis_1,
   unsigned char axis_linear, float feed_rate, float radius, unsigned char isclockwise, uint8_t extruder);
 
+#ifdef BEZIER_CURVE_SUPPORT
+// Execute a cubic Bezier curve in the XY plane from position to target. offset[0..1] is the first
+// control point relative to position, offset[2..3] the second control point relative to target.
+// Z and E are distributed along the curve length.
+void mc_bezier(float *position, float *target, float *offset, float feed_rate, uint8_t extruder);
+#endif
+
 #endif
@@ -60,6 +60,7 @@
 #include "UltiLCD2.h"
 #include "language.h"
 #include "preferences.h"
+#include "trace.h"
 
 //===========================================================================
 //=============================public variables ============================
@@ -985,6 +986,9 @@ block->steps_y = labs((target[X_AXIS]-position[X_AXIS]) - (target[Y_AXIS]-positi
   CRITICAL_SECTION_START
   block_buffer_head = next_buffer_head;
   CRITICAL_SECTION_END
+#ifdef EVENT_TRACE
+  trace_event(TRACE_PLAN_BUFFER, movesplanned());
+#endif
 
   // Update position
   memcpy(position, target, sizeof(position)); // position[] = target[]
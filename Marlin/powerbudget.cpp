@@ -122,8 +122,6 @@ static void PowerBudget_SaveSettings()
 
 #ifdef ENABLE_ULTILCD2
 
-#define WATTAGE_MENU_LEN   STORE_MENU_OFFSET+BED_MENU_OFFSET+EXTRUDERS+2
-
 
 static void lcd_powerbudget_store()
 {
@@ -131,68 +129,35 @@ static void lcd_powerbudget_store()
     menu.return_to_previous();
 }
 
-static void lcd_budget()
-{
-    lcd_tune_value(power_budget, POWER_MINVALUE, POWER_MAXVALUE);
-}
-
+#if STORE_MENU_OFFSET > 0
+static const char label_store[] PROGMEM = "Store options";
+#endif
+static const char label_back[] PROGMEM = "Click to return";
+static const char label_budget[] PROGMEM = "Total Power Budget";
 #if (TEMP_SENSOR_BED != 0)
-static void lcd_power_buildplate()
-{
-    lcd_tune_value(power_buildplate, POWER_MINVALUE, POWER_MAXVALUE);
-}
+static const char label_buildplate[] PROGMEM = "Wattage Buildplate";
 #endif
-
-static void lcd_power_extruder0()
-{
-    lcd_tune_value(power_extruder[0], POWER_MINVALUE, POWER_MAXVALUE);
-}
-
 #if (EXTRUDERS > 1)
-static void lcd_power_extruder1()
-{
-    lcd_tune_value(power_extruder[1], POWER_MINVALUE, POWER_MAXVALUE);
-}
+static const char label_extruder0[] PROGMEM = "Wattage Extruder 1";
+static const char label_extruder1[] PROGMEM = "Wattage Extruder 2";
+#else
+static const char label_extruder0[] PROGMEM = "Wattage Extruder";
 #endif
 
-static const menu_t & get_powerbudget_menuoption(uint8_t nr, menu_t &opt)
-{
-    uint8_t menu_index = 0;
-
+static const menu_item_t powerbudget_menu[] PROGMEM = {
 #if STORE_MENU_OFFSET > 0
-    if (nr == menu_index++)
-    {
-        opt.setData(MENU_NORMAL, lcd_powerbudget_store);
-    }
-    else if (nr == menu_index++)
-#else
-    if (nr == menu_index++)
-#endif // STORE_MENU_OFFSET
-    {
-        opt.setData(MENU_NORMAL, lcd_change_to_previous_menu);
-    }
-    else if (nr == menu_index++)
-    {
-        opt.setData(MENU_INPLACE_EDIT, lcd_budget, 4);
-    }
+    MENU_ACTION(lcd_powerbudget_store, label_store),
+#endif
+    MENU_ACTION(lcd_change_to_previous_menu, label_back),
+    MENU_VALUE(MENU_ITEM_UINT16, power_budget, POWER_MINVALUE, POWER_MAXVALUE, 4, label_budget),
 #if (TEMP_SENSOR_BED != 0)
-    else if (nr == menu_index++)
-    {
-        opt.setData(MENU_INPLACE_EDIT, lcd_power_buildplate, 4);
-    }
+    MENU_VALUE(MENU_ITEM_UINT16, power_buildplate, POWER_MINVALUE, POWER_MAXVALUE, 4, label_buildplate),
 #endif
-    else if (nr == menu_index++)
-    {
-        opt.setData(MENU_INPLACE_EDIT, lcd_power_extruder0, 4);
-    }
+    MENU_VALUE(MENU_ITEM_UINT16, power_extruder[0], POWER_MINVALUE, POWER_MAXVALUE, 4, label_extruder0),
 #if (EXTRUDERS > 1)
-    else if (nr == menu_index++)
-    {
-        opt.setData(MENU_INPLACE_EDIT, lcd_power_extruder1, 4);
-    }
+    MENU_VALUE(MENU_ITEM_UINT16, power_extruder[1], POWER_MINVALUE, POWER_MAXVALUE, 4, label_extruder1),
 #endif
-    return opt;
-}
+};
 
 static void drawPowerBudgetSubmenu (uint8_t nr, uint8_t &flags)
 {
@@ -201,14 +166,11 @@ static void drawPowerBudgetSubmenu (uint8_t nr, uint8_t &flags)
 
     const uint8_t ylineoffset = 15 - (2*BED_MENU_OFFSET) - (2*EXTRUDERS);
 
+    LCDMenu::drawItemLabel_P(powerbudget_menu, nr, flags);
+
 #if STORE_MENU_OFFSET > 0
     if (nr == index++)
     {
-        if (flags & MENU_SELECTED)
-        {
-            lcd_lib_draw_string_leftP(4, PSTR("Store options"));
-            flags |= MENU_STATUSLINE;
-        }
         LCDMenu::drawMenuString_P(LCD_CHAR_MARGIN_LEFT + 1
                           , BOTTOM_MENU_YPOS
                           , 52
@@ -229,8 +191,6 @@ static void drawPowerBudgetSubmenu (uint8_t nr, uint8_t &flags)
                            , flags);
         if (flags & MENU_SELECTED)
         {
-            lcd_lib_draw_string_leftP(4, PSTR("Click to return"));
-            flags |= MENU_STATUSLINE;
             lcd_lib_clear_stringP(LCD_GFX_WIDTH/2 + LCD_CHAR_MARGIN_LEFT + 4*LCD_CHAR_SPACING, BOTTOM_MENU_YPOS, PSTR("BACK"));
             lcd_lib_clear_gfx(LCD_GFX_WIDTH/2 + LCD_CHAR_MARGIN_LEFT + 2*LCD_CHAR_SPACING, BOTTOM_MENU_YPOS, backGfx);
         }
@@ -243,12 +203,6 @@ static void drawPowerBudgetSubmenu (uint8_t nr, uint8_t &flags)
     else if (nr == index++)
     {
         // Wattage Budget
-        if (flags & (MENU_SELECTED | MENU_ACTIVE))
-        {
-            lcd_lib_draw_string_leftP(4, PSTR("Total Power Budget"));
-            flags |= MENU_STATUSLINE;
-        }
-
         uint8_t ypos = (18 - BED_MENU_OFFSET - EXTRUDERS) + ((nr-2)*ylineoffset);
         lcd_lib_draw_string_leftP(ypos, PSTR("Total"));
         int_to_string(power_budget, buffer, PSTR("W"));
@@ -264,12 +218,6 @@ static void drawPowerBudgetSubmenu (uint8_t nr, uint8_t &flags)
     else if (nr == index++)
     {
         // Wattage Buildplate
-        if (flags & (MENU_SELECTED | MENU_ACTIVE))
-        {
-            lcd_lib_draw_string_leftP(4, PSTR("Wattage Buildplate"));
-            flags |= MENU_STATUSLINE;
-        }
-
         uint8_t ypos = (18 - BED_MENU_OFFSET - EXTRUDERS) + ((nr-2)*ylineoffset);
         lcd_lib_draw_string_leftP(ypos, PSTR("Buildplate"));
         int_to_string(power_buildplate, buffer, PSTR("W"));
@@ -285,15 +233,6 @@ static void drawPowerBudgetSubmenu (uint8_t nr, uint8_t &flags)
     else if (nr == index++)
     {
         // Wattage Extruder 0
-        if (flags & (MENU_SELECTED | MENU_ACTIVE))
-        {
-            lcd_lib_draw_string_leftP(4, PSTR("Wattage Extruder"));
-          #if EXTRUDERS > 1
-            lcd_lib_draw_stringP(LCD_CHAR_MARGIN_LEFT+17*LCD_CHAR_SPACING, 4, PSTR("1"));
-          #endif
-            flags |= MENU_STATUSLINE;
-        }
-
         uint8_t ypos = (18 - BED_MENU_OFFSET - EXTRUDERS) + ((nr-2)*ylineoffset);
         lcd_lib_draw_string_leftP(ypos, PSTR("Extruder"));
       #if EXTRUDERS > 1
@@ -312,15 +251,6 @@ static void drawPowerBudgetSubmenu (uint8_t nr, uint8_t &flags)
     else if (nr == index++)
     {
         // Wattage Extruder 1
-        if (flags & (MENU_SELECTED | MENU_ACTIVE))
-        {
-            lcd_lib_draw_string_leftP(4, PSTR("Wattage Extruder"));
-          #if EXTRUDERS > 1
-            lcd_lib_draw_stringP(LCD_CHAR_MARGIN_LEFT+17*LCD_CHAR_SPACING, 4, PSTR("2"));
-          #endif
-            flags |= MENU_STATUSLINE;
-        }
-
         uint8_t ypos = (18 - BED_MENU_OFFSET - EXTRUDERS) + ((nr-2)*ylineoffset);
         lcd_lib_draw_string_leftP(ypos, PSTR("Extruder 2"));
         int_to_string(power_extruder[1], buffer, PSTR("W"));
@@ -340,10 +270,10 @@ void lcd_menu_powerbudget()
     lcd_basic_screen();
     lcd_lib_draw_hline(3, 124, 12);
 
-    menu.process_submenu(get_powerbudget_menuoption, WATTAGE_MENU_LEN);
+    menu.process_submenu_P(powerbudget_menu, COUNT(powerbudget_menu));
 
     uint8_t flags = 0;
-    for (uint8_t index=0; index<WATTAGE_MENU_LEN; ++index) {
+    for (uint8_t index=0; index<COUNT(powerbudget_menu); ++index) {
         menu.drawSubMenu(drawPowerBudgetSubmenu, index, flags);
     }
 
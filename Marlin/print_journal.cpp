@@ -0,0 +1,319 @@
+#include <avr/eeprom.h>
+#include <stddef.h>
+#include "print_journal.h"
+#include "planner.h"
+#include "cardreader.h"
+
+#if defined(SDSUPPORT) && defined(POWER_LOSS_JOURNAL)
+
+//0xE00 to the end of the EEPROM is unused by the other settings (see lifetime_stats.cpp).
+//A header describes the printed file. Every layer start gets a small record that rotates through most of the space,
+//so the writes are spread out. The temperatures, extruder and relative modes rarely change, they are kept in two
+//state slots that are written in turn, only when they differ from the last written state.
+#define JOURNAL_EEPROM_OFFSET 0xE00
+#define JOURNAL_EEPROM_END    0x1000
+#define JOURNAL_STATE_OFFSET  (JOURNAL_EEPROM_OFFSET + sizeof(journal_header_t))
+#define JOURNAL_STATE_ADDR(n) ((uint8_t*)(JOURNAL_STATE_OFFSET + uint16_t(n) * sizeof(journal_state_t)))
+#define JOURNAL_RECORD_OFFSET (JOURNAL_STATE_OFFSET + 2 * sizeof(journal_state_t))
+#define JOURNAL_RECORDS       ((JOURNAL_EEPROM_END - JOURNAL_RECORD_OFFSET) / sizeof(journal_layer_t))
+#define JOURNAL_RECORD_ADDR(n) ((uint8_t*)(JOURNAL_RECORD_OFFSET + uint16_t(n) * sizeof(journal_layer_t)))
+
+#define JOURNAL_ACTIVE 0x4B
+#define JOURNAL_NAME_LENGTH 20
+// a smaller change of the extrusion height is not a new layer (spiralized prints climb with every move)
+#define JOURNAL_LAYER_MIN 0.02f
+// layer starts that are read from the file before the stepper gets there, waiting to be written
+#define JOURNAL_QUEUE_SIZE 4
+
+typedef struct
+{
+  uint8_t state;         // JOURNAL_ACTIVE while a print is running
+  uint32_t cluster;      // first cluster and size identify the printed file
+  uint32_t size;
+  char name[JOURNAL_NAME_LENGTH+1];
+} journal_header_t;
+
+// written at every layer start
+typedef struct
+{
+  uint16_t seq;          // increases with every record, the highest valid one is the newest
+  uint32_t filepos;
+  int16_t x;             // 1/100 mm
+  int16_t y;
+  uint16_t z;
+  float e;
+  uint16_t feedrate;     // mm/min
+  uint8_t fan;
+  uint8_t checksum;
+} journal_layer_t;
+
+// written before the first layer record it belongs to
+typedef struct
+{
+  uint16_t seq;          // the first layer record with this state
+  uint8_t relative;
+  uint8_t extruder;
+  uint16_t temperature[EXTRUDERS];
+  uint16_t bed;
+  uint8_t checksum;
+} journal_state_t;
+
+typedef struct
+{
+  journal_layer_t layer;
+  journal_state_t state;
+  bool new_state;        // the state is written before the layer
+  uint8_t blocks;        // planned moves before the layer start that the stepper has not finished yet
+} journal_pending_t;
+
+static journal_header_t journal_header;
+static journal_record_t journal_rec;   // the interrupted print's record
+static journal_pending_t journal_queue[JOURNAL_QUEUE_SIZE];
+static uint8_t journal_queued = 0;     // journal_queue[0] is written first
+static uint8_t journal_written;        // bytes of journal_queue[0] that are written
+static journal_state_t journal_state;  // the last queued state
+static bool journal_state_valid;       // journal_state belongs to the current print
+static bool journal_active = false;
+static bool journal_found = false;
+static uint8_t journal_slot;           // next layer record slot to write
+static uint8_t journal_state_slot;     // next state slot to write
+static uint16_t journal_seq;
+static uint8_t journal_tail;
+static float journal_z;                // extrusion height of the last journaled layer
+
+// over the record up to its checksum
+static uint8_t journal_checksum(const void *record, uint8_t size)
+{
+  const uint8_t *p = (const uint8_t *)record;
+  uint8_t sum = 0;
+  while (size--)
+    sum += *p++;
+  return ~sum;
+}
+
+void journal_init()
+{
+  eeprom_read_block(&journal_header, (const void*)JOURNAL_EEPROM_OFFSET, sizeof(journal_header));
+  journal_header.name[JOURNAL_NAME_LENGTH] = '\0';
+
+  // continue the ring after the newest record, also when it belongs to a finished print
+  journal_layer_t layer, newest;
+  bool found = false;
+  journal_slot = 0;
+  journal_seq = 0;
+  for (uint8_t n = 0; n < JOURNAL_RECORDS; ++n)
+  {
+    eeprom_read_block(&layer, JOURNAL_RECORD_ADDR(n), sizeof(layer));
+    if (layer.checksum != journal_checksum(&layer, offsetof(journal_layer_t, checksum)))
+      continue;
+    if (found && int16_t(layer.seq - newest.seq) <= 0)
+      continue;
+    newest = layer;
+    found = true;
+    journal_slot = n + 1;
+  }
+  if (journal_slot >= JOURNAL_RECORDS)
+    journal_slot = 0;
+  if (found)
+    journal_seq = newest.seq + 1;
+
+  // the newest state that was complete before that record, a newer one belongs to a record that was never written
+  journal_state_t state, newest_state;
+  bool state_found = false;
+  journal_state_slot = 0;
+  for (uint8_t n = 0; n < 2; ++n)
+  {
+    eeprom_read_block(&state, JOURNAL_STATE_ADDR(n), sizeof(state));
+    if (!found || (state.checksum != journal_checksum(&state, offsetof(journal_state_t, checksum))) || (int16_t(state.seq - newest.seq) > 0))
+      continue;
+    if (state_found && int16_t(state.seq - newest_state.seq) <= 0)
+      continue;
+    newest_state = state;
+    state_found = true;
+    journal_state_slot = n ^ 1;
+  }
+
+  journal_found = state_found && (journal_header.state == JOURNAL_ACTIVE);
+  if (journal_found)
+  {
+    journal_rec.filepos = newest.filepos;
+    journal_rec.position[X_AXIS] = newest.x / 100.0f;
+    journal_rec.position[Y_AXIS] = newest.y / 100.0f;
+    journal_rec.position[Z_AXIS] = newest.z / 100.0f;
+    journal_rec.position[E_AXIS] = newest.e;
+    journal_rec.feedrate = newest.feedrate;
+    journal_rec.fan = newest.fan;
+    journal_rec.relative = newest_state.relative;
+    journal_rec.extruder = newest_state.extruder;
+    for (uint8_t e=0; e<EXTRUDERS; ++e)
+      journal_rec.temperature[e] = newest_state.temperature[e];
+    journal_rec.bed = newest_state.bed;
+
+    SERIAL_ECHO_START;
+    SERIAL_ECHOPGM("Interrupted print: ");
+    SERIAL_ECHOLN(journal_header.name);
+  }
+}
+
+void journal_start()
+{
+  journal_header.state = JOURNAL_ACTIVE;
+  journal_header.cluster = card.getFileCluster();
+  journal_header.size = card.getFileSize();
+  strncpy(journal_header.name, card.currentLongFileName(), JOURNAL_NAME_LENGTH);
+  journal_header.name[JOURNAL_NAME_LENGTH] = '\0';
+  eeprom_update_block(&journal_header, (void*)JOURNAL_EEPROM_OFFSET, sizeof(journal_header));
+
+  journal_found = false;
+  journal_queued = 0;
+  journal_written = 0;
+  journal_state_valid = false;
+  journal_z = -1.0f;
+  journal_active = true;
+}
+
+void journal_stop()
+{
+  journal_found = false;
+  journal_active = false;
+  journal_queued = 0;
+  journal_written = 0;
+  journal_header.state = 0;
+  eeprom_update_byte((uint8_t*)JOURNAL_EEPROM_OFFSET, 0);
+}
+
+bool journal_due(float z)
+{
+  return journal_active && (printing_state == PRINT_STATE_NORMAL) && (fabs(z - journal_z) >= JOURNAL_LAYER_MIN);
+}
+
+// counts the moves the stepper has finished since the last call off the queued layer starts
+static void journal_update_blocks()
+{
+  uint8_t tail = block_buffer_tail;
+  uint8_t done = (tail - journal_tail) & (BLOCK_BUFFER_SIZE - 1);
+  journal_tail = tail;
+  bool idle = !blocks_queued();
+  for (uint8_t n = 0; n < journal_queued; ++n)
+  {
+    if (idle || (journal_queue[n].blocks <= done))
+      journal_queue[n].blocks = 0;
+    else
+      journal_queue[n].blocks -= done;
+  }
+}
+
+void journal_add(const journal_record_t &record, float z)
+{
+  journal_update_blocks();
+  journal_pending_t *entry = &journal_queue[journal_queued];
+  if (journal_queued == JOURNAL_QUEUE_SIZE)
+  {
+    // more layers than the planner buffer can hold moves for, the newest waiting one is replaced
+    --entry;
+    --journal_seq;
+  }
+  else
+  {
+    entry->new_state = false;
+    ++journal_queued;
+  }
+
+  journal_state_t &state = entry->state;
+  memset(&state, 0, sizeof(state));
+  state.relative = record.relative;
+  state.extruder = record.extruder;
+  for (uint8_t e=0; e<EXTRUDERS; ++e)
+    state.temperature[e] = record.temperature[e];
+  state.bed = record.bed;
+  state.seq = journal_state.seq;
+  state.checksum = journal_state.checksum;
+  if (!journal_state_valid || memcmp(&state, &journal_state, sizeof(state)))
+  {
+    state.seq = journal_seq;
+    state.checksum = journal_checksum(&state, offsetof(journal_state_t, checksum));
+    journal_state = state;
+    journal_state_valid = true;
+    entry->new_state = true;
+  }
+  else if (entry->new_state)
+  {
+    // a replaced entry still has to write the state it changed
+    state = journal_state;
+  }
+
+  journal_layer_t &layer = entry->layer;
+  layer.seq = journal_seq++;
+  layer.filepos = record.filepos;
+  layer.x = lround(record.position[X_AXIS] * 100.0f);
+  layer.y = lround(record.position[Y_AXIS] * 100.0f);
+  layer.z = lround(record.position[Z_AXIS] * 100.0f);
+  layer.e = record.position[E_AXIS];
+  layer.feedrate = record.feedrate;
+  layer.fan = record.fan;
+  layer.checksum = journal_checksum(&layer, offsetof(journal_layer_t, checksum));
+  entry->blocks = movesplanned();
+  journal_z = z;
+}
+
+void journal_tick()
+{
+  if (!journal_queued)
+    return;
+  // a record only becomes true once the stepper has executed the moves that were planned before it
+  journal_update_blocks();
+  journal_pending_t *entry = &journal_queue[0];
+  // a single byte per call, so the main loop never waits for the EEPROM
+  if (entry->blocks || !eeprom_is_ready())
+    return;
+  if (entry->new_state)
+  {
+    // the state first, a layer record is only valid with the state of its time
+    eeprom_write_byte(JOURNAL_STATE_ADDR(journal_state_slot) + journal_written, ((const uint8_t *)&entry->state)[journal_written]);
+    if (++journal_written == sizeof(journal_state_t))
+    {
+      journal_state_slot ^= 1;
+      entry->new_state = false;
+      journal_written = 0;
+    }
+    return;
+  }
+  eeprom_write_byte(JOURNAL_RECORD_ADDR(journal_slot) + journal_written, ((const uint8_t *)&entry->layer)[journal_written]);
+  if (++journal_written == sizeof(journal_layer_t))
+  {
+    if (++journal_slot >= JOURNAL_RECORDS)
+      journal_slot = 0;
+    journal_written = 0;
+    --journal_queued;
+    for (uint8_t n = 0; n < journal_queued; ++n)
+      journal_queue[n] = journal_queue[n + 1];
+  }
+}
+
+bool journal_interrupted()
+{
+  return journal_found;
+}
+
+const journal_record_t &journal_last()
+{
+  return journal_rec;
+}
+
+const char *journal_name()
+{
+  return journal_header.name;
+}
+
+bool journal_find(float z, journal_record_t &record)
+{
+  if (!journal_found || (card.getFileCluster() != journal_header.cluster) || (card.getFileSize() != journal_header.size))
+    return false;
+  // a changed recover height means the user wants to start somewhere else
+  if (fabs(journal_rec.position[Z_AXIS] - z) > 0.005f)
+    return false;
+  record = journal_rec;
+  return true;
+}
+
+#endif
@@ -0,0 +1,37 @@
+#ifndef PRINT_JOURNAL_H
+#define PRINT_JOURNAL_H
+
+#include "Marlin.h"
+
+#if defined(SDSUPPORT) && defined(POWER_LOSS_JOURNAL)
+
+// State of the SD print right before the command at filepos, all moves planned before it have been executed
+typedef struct
+{
+  uint32_t filepos;
+  float position[NUM_AXIS];
+  uint16_t feedrate;                // mm/min
+  uint8_t fan;
+  uint8_t relative;                 // axis_relative_state
+  uint8_t extruder;
+  uint16_t temperature[EXTRUDERS];  // hotend targets
+  uint16_t bed;
+} journal_record_t;
+
+void journal_init();
+void journal_tick();
+void journal_start();
+void journal_stop();
+// true when a command that extrudes at height z starts a layer that is not journaled yet
+bool journal_due(float z);
+void journal_add(const journal_record_t &record, float z);
+
+// the print that was running when the printer was reset, if any
+bool journal_interrupted();
+const journal_record_t &journal_last();
+const char *journal_name();
+// the interrupted print's record, if the open file is the interrupted one and z is its height
+bool journal_find(float z, journal_record_t &record);
+
+#endif
+#endif //PRINT_JOURNAL_H
@@ -0,0 +1,181 @@
+#include "print_log.h"
+#include "planner.h"
+#include "temperature.h"
+#include "cardreader.h"
+
+#if defined(SDSUPPORT) && defined(PRINT_LOG)
+
+#define PRINT_LOG_LINE_LENGTH 48
+
+static SdFile log_file;
+static bool log_active = false;
+// lines waiting to be written, kept at the front so a whole block can be written straight from here
+static char log_buffer[PRINT_LOG_BUFFER_SIZE];
+static uint16_t log_length = 0;
+static uint16_t log_lost;
+static char log_line[PRINT_LOG_LINE_LENGTH];
+static uint8_t log_line_length;
+static unsigned long log_start_millis;
+static unsigned long log_next_sample;
+static unsigned long log_layer_millis;
+static float log_top;
+
+// a line that gets too long is cut off, the last character is kept for its end
+static void line_char(char c)
+{
+  if (log_line_length < PRINT_LOG_LINE_LENGTH - 1)
+    log_line[log_line_length++] = c;
+}
+
+static void line_number(long n)
+{
+  char digits[10];
+  uint8_t i = 0;
+  // a broken sensor can read below zero
+  if (n < 0)
+  {
+    line_char('-');
+    n = -n;
+  }
+  do {
+    digits[i++] = '0' + n % 10;
+    n /= 10;
+  } while (n);
+  while (i)
+    line_char(digits[--i]);
+}
+
+static void line_begin(char type)
+{
+  log_line_length = 0;
+  line_char(type);
+  line_char(' ');
+  line_number((millis() - log_start_millis) / 1000);
+  line_char(' ');
+}
+
+static void line_end()
+{
+  log_line[log_line_length++] = '\n';
+  if (log_length + log_line_length > PRINT_LOG_BUFFER_SIZE)
+  {
+    // the card could not keep up, rather lose the line than wait for it
+    ++log_lost;
+    return;
+  }
+  memcpy(log_buffer + log_length, log_line, log_line_length);
+  log_length += log_line_length;
+}
+
+static void log_write(uint16_t n)
+{
+  if (log_file.write(log_buffer, n) != int16_t(n))
+  {
+    // card removed or full, stop logging this print
+    log_file.close();
+    log_active = false;
+    log_length = 0;
+    return;
+  }
+  log_length -= n;
+  memmove(log_buffer, log_buffer + n, log_length);
+}
+
+void print_log_start()
+{
+  if (log_active)
+    return;
+  log_active = card.openPrintLog(log_file);
+  if (!log_active)
+    return;
+  log_length = 0;
+  log_lost = 0;
+  log_start_millis = millis();
+  log_next_sample = log_start_millis;
+  log_layer_millis = log_start_millis;
+  log_top = 0.0f;
+
+  line_begin('S');
+  for (const char *name = card.currentLongFileName(); *name; ++name)
+    line_char(*name);
+  line_end();
+}
+
+void print_log_stop()
+{
+  if (!log_active)
+    return;
+  line_begin('F');
+  line_number(log_lost);
+  line_end();
+  if (log_length)
+    log_write(log_length);
+  log_file.close();
+  log_active = false;
+}
+
+void print_log_move(float z)
+{
+  // like the layer index, a z-hop raises the top and the layers below it are not logged again
+  if (!log_active || z <= log_top + 0.001f)
+    return;
+  log_top = z;
+  unsigned long now = millis();
+  uint16_t z100 = z * 100.0f + 0.5f;
+  line_begin('L');
+  line_number(z100 / 100);
+  line_char('.');
+  line_char('0' + (z100 / 10) % 10);
+  line_char('0' + z100 % 10);
+  line_char(' ');
+  line_number((now - log_layer_millis) / 1000);
+  line_end();
+  log_layer_millis = now;
+}
+
+void print_log_error(uint8_t reason)
+{
+  if (!log_active)
+    return;
+  line_begin('E');
+  line_number(reason);
+  line_end();
+}
+
+void print_log_tick()
+{
+  if (!log_active)
+    return;
+  if ((long)(millis() - log_next_sample) >= 0)
+  {
+    log_next_sample += PRINT_LOG_INTERVAL * 1000UL;
+    line_begin('T');
+    for (uint8_t e = 0; e < EXTRUDERS; ++e)
+    {
+      line_number(int(degHotend(e) + 0.5f));
+      line_char('/');
+      line_number(degTargetHotend(e));
+      line_char(' ');
+    }
+#if TEMP_SENSOR_BED != 0
+    line_char('B');
+    line_number(int(degBed() + 0.5f));
+    line_char('/');
+    line_number(degTargetBed());
+#endif
+    line_end();
+  }
+
+  // only write when it completes the block the file ends in, so every block is written once and a
+  // full block goes to the card without passing the cache the printed file is read through
+  uint16_t room = 512 - (log_file.curPosition() & 0x1FF);
+  // (a buffer smaller than that block is written when it is 3/4 full)
+  if (log_length < room && (room <= PRINT_LOG_BUFFER_SIZE || log_length <= PRINT_LOG_BUFFER_SIZE * 3 / 4))
+    return;
+  // and only when the moves buffered are enough to cover the card's write time
+  if (blocks_queued() && movesplanned() < BLOCK_BUFFER_SIZE / 2)
+    return;
+  log_write(min(log_length, room));
+}
+
+#endif
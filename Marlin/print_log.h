@@ -0,0 +1,22 @@
+#ifndef PRINT_LOG_H
+#define PRINT_LOG_H
+
+#include "Marlin.h"
+
+#if defined(SDSUPPORT) && defined(PRINT_LOG)
+
+// Lines of PRINT_LOG_FILENAME, times are seconds since the print started:
+//   S <time> <file>                 print started
+//   L <time> <z> <seconds>          layer at height z started, the previous layer took <seconds>
+//   T <time> <hotend>/<target> ... B<bed>/<target>
+//   E <time> <reason>               the printer was stopped, see STOP_REASON_*
+//   F <time> <lost lines>           print ended, lines that did not fit in the buffer are counted
+void print_log_start();
+void print_log_stop();
+// a move from the SD card to height z
+void print_log_move(float z);
+void print_log_error(uint8_t reason);
+void print_log_tick();
+
+#endif
+#endif //PRINT_LOG_H
@@ -0,0 +1,75 @@
+#include "scheduler.h"
+
+#ifdef IDLE_SCHEDULER
+
+struct idle_task_stats_t {
+  unsigned long runs;
+  unsigned long total_us;
+  uint16_t max_us;
+  uint16_t deferred;
+  uint16_t last_run;  // low bits of millis(), enough for the period and the deferral limit
+};
+
+static idle_task_stats_t task_stats[IDLE_TASKS_MAX];
+
+void scheduler_run(const idle_task_t *tasks, uint8_t count, bool hungry)
+{
+  unsigned long start = micros();
+  uint16_t now = millis();
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    idle_task_t task;
+    memcpy_P(&task, &tasks[i], sizeof(task));
+    idle_task_stats_t &stats = task_stats[i];
+    uint16_t elapsed = now - stats.last_run;
+    if (elapsed < task.period)
+      continue;
+    if ((task.flags & IDLE_TASK_DEFERRABLE) && elapsed < IDLE_TASK_MAX_DEFER
+        && (hungry || micros() - start > IDLE_TASK_BUDGET))
+    {
+      if (stats.deferred < 0xFFFF)
+        ++stats.deferred;
+      continue;
+    }
+    stats.last_run = now;
+    unsigned long t = micros();
+    task.func();
+    t = micros() - t;
+    ++stats.runs;
+    stats.total_us += t;
+    if (t > stats.max_us)
+      stats.max_us = min(t, 0xFFFFUL);
+  }
+}
+
+void scheduler_print_stats(const idle_task_t *tasks, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; ++i)
+  {
+    const char *name;
+    memcpy_P(&name, &tasks[i].name, sizeof(name));
+    const idle_task_stats_t &stats = task_stats[i];
+    serialprintPGM(name);
+    SERIAL_PROTOCOLPGM(" runs:");
+    SERIAL_PROTOCOL(stats.runs);
+    SERIAL_PROTOCOLPGM(" deferred:");
+    SERIAL_PROTOCOL(stats.deferred);
+    SERIAL_PROTOCOLPGM(" avg:");
+    SERIAL_PROTOCOL(stats.runs ? stats.total_us / stats.runs : 0);
+    SERIAL_PROTOCOLPGM(" max:");
+    SERIAL_PROTOCOLLN(stats.max_us);
+  }
+}
+
+void scheduler_reset_stats()
+{
+  for (uint8_t i = 0; i < IDLE_TASKS_MAX; ++i)
+  {
+    task_stats[i].runs = 0;
+    task_stats[i].total_us = 0;
+    task_stats[i].max_us = 0;
+    task_stats[i].deferred = 0;
+  }
+}
+
+#endif
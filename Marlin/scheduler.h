@@ -0,0 +1,29 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "Marlin.h"
+
+#ifdef IDLE_SCHEDULER
+
+#define IDLE_TASKS_MAX 6
+
+// task flags
+#define IDLE_TASK_CRITICAL   0
+#define IDLE_TASK_DEFERRABLE 1
+
+// One task of idle(), tables of these are kept in PROGMEM in priority order.
+struct idle_task_t {
+  void (*func)();
+  const char *name;   // PROGMEM
+  uint16_t period;    // minimum milliseconds between two runs, 0 to run on every pass
+  uint8_t flags;
+};
+
+// Run the due tasks of the table, count is at most IDLE_TASKS_MAX. When hungry the planner needs commands, so the deferrable tasks are skipped.
+void scheduler_run(const idle_task_t *tasks, uint8_t count, bool hungry);
+// M46: per task "<name> runs:<n> deferred:<n> avg:<us> max:<us>"
+void scheduler_print_stats(const idle_task_t *tasks, uint8_t count);
+void scheduler_reset_stats();
+
+#endif
+#endif //SCHEDULER_H
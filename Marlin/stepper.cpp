@@ -30,6 +30,8 @@
 #include "language.h"
 #include "lifetime_stats.h"
 #include "speed_lookuptable.h"
+#include "telemetry.h"
+#include "trace.h"
 #if defined(DIGIPOTSS_PIN) && DIGIPOTSS_PIN > -1
 #include <SPI.h>
 #endif
@@ -101,38 +103,42 @@ static bool check_endstops = true;
 volatile long count_position[NUM_AXIS] = { 0, 0, 0, 0};
 volatile signed char count_direction[NUM_AXIS] = { 1, 1, 1, 1};
 
+#if defined(BABYSTEPPING)
+  // Signed babystep counts per axis, consumed by the stepper interrupt
+  static volatile int16_t babystepsTodo[3] = { 0, 0, 0 };
+  // Stepper timer ticks elapsed since the last babystep
+  static uint16_t babystep_ticks = 0;
+  #define BABYSTEP_TICKS ((F_CPU / 8000000UL) * BABYSTEP_MIN_INTERVAL)
+  static FORCE_INLINE void babystep_isr();
+#endif
+
 //===========================================================================
 //=============================functions         ============================
 //===========================================================================
 
-#define CHECK_ENDSTOPS  if(check_endstops)
+// Endstop numbering, used as bit index in endstop_irq_pins
+#define ENDSTOP_X_MIN 0
+#define ENDSTOP_X_MAX 1
+#define ENDSTOP_Y_MIN 2
+#define ENDSTOP_Y_MAX 3
+#define ENDSTOP_Z_MIN 4
+#define ENDSTOP_Z_MAX 5
+
+#ifdef ENDSTOP_INTERRUPTS_FEATURE
+  // Endstops on a pin with pin change interrupt are watched by endstop_isr(), the others are polled on every step
+  static uint8_t endstop_irq_pins = 0;
+  #define CHECK_ENDSTOP(endstop)  if(check_endstops && !(endstop_irq_pins & _BV(endstop)))
+  // Endstops that read triggered, with the step count at that moment. They end the block when the stepper ISR
+  // still reads them triggered on its next run, the same two sample debounce as the polled endstops.
+  static volatile uint8_t endstop_irq_pending = 0;
+  static long endstop_irq_steps[3];
+  static void endstop_isr();
+  static void endstop_irq_confirm();
+#else
+  #define CHECK_ENDSTOP(endstop)  if(check_endstops)
+#endif
 
 #ifdef __AVR
-// intRes = intIn1 * intIn2 >> 16
-// uses:
-// r26 to store 0
-// r27 to store the byte 1 of the 24 bit result
-#define MultiU16X8toH16(intRes, charIn1, intIn2) \
-    asm volatile ( \
-    "clr r26 \n\t" \
-    "mul %A1, %B2 \n\t" \
-    "movw %A0, r0 \n\t" \
-    "mul %A1, %A2 \n\t" \
-    "add %A0, r1 \n\t" \
-    "adc %B0, r26 \n\t" \
-    "lsr r0 \n\t" \
-    "adc %A0, r26 \n\t" \
-    "adc %B0, r26 \n\t" \
-    "clr r1 \n\t" \
-    : \
-    "=&r" (intRes) \
-    : \
-    "d" (charIn1), \
-    "d" (intIn2) \
-    : \
-    "r26" \
-    )
-
 // intRes = longIn1 * longIn2 >> 24
 // uses:
 // r26 to store 0
@@ -189,9 +195,6 @@ asm volatile ( \
 )
 #else
 
-// intRes = intIn1 * intIn2 >> 16
-#define MultiU16X8toH16(intRes, charIn1, intIn2) do { (intRes) = (uint32_t(charIn1) * uint32_t(intIn2)) >> 16; } while(0)
-
 // intRes = longIn1 * longIn2 >> 24
 #define MultiU24X32toH16(intRes, longIn1, longIn2) do { (intRes) = (uint64_t(longIn1) * uint64_t(longIn2)) >> 24; } while(0)
 #endif
@@ -252,6 +255,15 @@ void endstops_hit_on_purpose()
 void enable_endstops(bool check)
 {
   check_endstops = check;
+#ifdef ENDSTOP_INTERRUPTS_FEATURE
+  if (check)
+  {
+    // an endstop that is already pressed gives no pin change
+    CRITICAL_SECTION_START;
+    endstop_isr();
+    CRITICAL_SECTION_END;
+  }
+#endif
 }
 
 //         __________________________
@@ -282,36 +294,7 @@ void step_wait(){
 
 
 FORCE_INLINE uint16_t calc_timer(uint16_t step_rate) {
-  uint16_t timer;
-  if(step_rate > MAX_STEP_FREQUENCY) step_rate = MAX_STEP_FREQUENCY;
-
-  if(step_rate > 20000) { // If steprate > 20kHz >> step 4 times
-    step_rate = (step_rate >> 2)&0x3fff;
-    step_loops = 4;
-  }
-  else if(step_rate > 10000) { // If steprate > 10kHz >> step 2 times
-    step_rate = (step_rate >> 1)&0x7fff;
-    step_loops = 2;
-  }
-  else {
-    step_loops = 1;
-  }
-
-  if(step_rate < (F_CPU/500000)) step_rate = (F_CPU/500000);
-  step_rate -= (F_CPU/500000); // Correct for minimal speed
-  if(step_rate >= (8*256)){ // higher step rate
-    const uint8_t* table_address = (const uint8_t*)&speed_lookuptable_fast[(unsigned char)(step_rate>>8)][0];
-    unsigned char tmp_step_rate = (step_rate & 0x00ff);
-    uint16_t gain = (uint16_t)pgm_read_word_near(table_address+2);
-    MultiU16X8toH16(timer, tmp_step_rate, gain);
-    timer = (uint16_t)pgm_read_word_near(table_address) - timer;
-  }
-  else { // lower step rates
-    const uint8_t* table_address = (const uint8_t*)&speed_lookuptable_slow[0][0];
-    table_address += ((step_rate)>>1) & 0xfffc;
-    timer = (uint16_t)pgm_read_word_near(table_address);
-    timer -= (((uint16_t)pgm_read_word_near(table_address+2) * (unsigned char)(step_rate & 0x0007))>>3);
-  }
+  uint16_t timer = speed_lookup_timer(step_rate, step_loops);
   if(timer < 100) { timer = 100; MYSERIAL.print(MSG_STEPPER_TOO_HIGH); MYSERIAL.println(step_rate); }//(20kHz this should never happen)
   return timer;
 }
@@ -355,11 +338,25 @@ FORCE_INLINE void trapezoid_generator_reset() {
 // It pops blocks from the block_buffer and executes them by pulsing the stepper pins appropriately.
 ISR(TIMER1_COMPA_vect)
 {
+#if defined(BABYSTEPPING)
+  // the compare value still holds the length of the period that just ended
+  babystep_isr();
+#endif
+
+#ifdef ENDSTOP_INTERRUPTS_FEATURE
+  // second sample of the endstops that triggered since the last run
+  if (endstop_irq_pending && current_block != NULL)
+    endstop_irq_confirm();
+#endif
+
   // If there is no current block, attempt to pop one from the buffer
   if (current_block == NULL) {
     // Anything in the buffer?
     current_block = plan_get_current_block();
     if (current_block != NULL) {
+#ifdef EVENT_TRACE
+      trace_event(TRACE_BLOCK_START, block_buffer_tail);
+#endif
       trapezoid_generator_reset();
 
       // Initialize Bresenham counters to 1/2 the ceiling
@@ -371,6 +368,11 @@ ISR(TIMER1_COMPA_vect)
 
       // Set directions, This should be done once during init of trapezoid. Endstops -> interrupt
       out_bits = current_block->direction_bits;
+#ifdef ENDSTOP_INTERRUPTS_FEATURE
+      // pending endstops were for the previous block, sample again for this one
+      endstop_irq_pending = 0;
+      endstop_isr();
+#endif
 
       // Set the direction bits (X_AXIS=A_AXIS and Y_AXIS=B_AXIS for COREXY)
       if((out_bits & (1<<X_AXIS))!=0){
@@ -530,7 +532,7 @@ ISR(TIMER1_COMPA_vect)
     #else
     if ((((out_bits & (1<<X_AXIS)) != 0)&&(out_bits & (1<<Y_AXIS)) != 0)) {   //-X occurs for -A and -B
     #endif
-      CHECK_ENDSTOPS
+      CHECK_ENDSTOP(ENDSTOP_X_MIN)
       {
         #if defined(X_MIN_PIN) && X_MIN_PIN > -1
           bool x_min_endstop=(READ(X_MIN_PIN) != X_ENDSTOPS_INVERTING);
@@ -544,7 +546,7 @@ ISR(TIMER1_COMPA_vect)
       }
     }
     else { // +direction
-      CHECK_ENDSTOPS
+      CHECK_ENDSTOP(ENDSTOP_X_MAX)
       {
         #if defined(X_MAX_PIN) && X_MAX_PIN > -1
           bool x_max_endstop=(READ(X_MAX_PIN) != X_ENDSTOPS_INVERTING);
@@ -563,7 +565,7 @@ ISR(TIMER1_COMPA_vect)
     #else
     if ((((out_bits & (1<<X_AXIS)) != 0)&&(out_bits & (1<<Y_AXIS)) == 0)) {   // -Y occurs for -A and +B
     #endif
-      CHECK_ENDSTOPS
+      CHECK_ENDSTOP(ENDSTOP_Y_MIN)
       {
         #if defined(Y_MIN_PIN) && Y_MIN_PIN > -1
           bool y_min_endstop=(READ(Y_MIN_PIN) != Y_ENDSTOPS_INVERTING);
@@ -577,7 +579,7 @@ ISR(TIMER1_COMPA_vect)
       }
     }
     else { // +direction
-      CHECK_ENDSTOPS
+      CHECK_ENDSTOP(ENDSTOP_Y_MAX)
       {
         #if defined(Y_MAX_PIN) && Y_MAX_PIN > -1
           bool y_max_endstop=(READ(Y_MAX_PIN) != Y_ENDSTOPS_INVERTING);
@@ -592,7 +594,7 @@ ISR(TIMER1_COMPA_vect)
     }
 
     if ((out_bits & (1<<Z_AXIS)) != 0) {   // -direction
-      CHECK_ENDSTOPS
+      CHECK_ENDSTOP(ENDSTOP_Z_MIN)
       {
         #if defined(Z_MIN_PIN) && Z_MIN_PIN > -1
           bool z_min_endstop=(READ(Z_MIN_PIN) != Z_ENDSTOPS_INVERTING);
@@ -606,7 +608,7 @@ ISR(TIMER1_COMPA_vect)
       }
     }
     else { // +direction
-      CHECK_ENDSTOPS
+      CHECK_ENDSTOP(ENDSTOP_Z_MAX)
       {
         #if defined(Z_MAX_PIN) && Z_MAX_PIN > -1
           bool z_max_endstop=(READ(Z_MAX_PIN) != Z_ENDSTOPS_INVERTING);
@@ -743,17 +745,163 @@ ISR(TIMER1_COMPA_vect)
     // Hack to address stuttering caused by ISR not finishing in time.
     // When the ISR does not finish in time, the timer will wrap in the computation of the next interrupt time.
     // This hack replaces the correct (past) time with a time not far in the future.
+#ifdef LOOP_TELEMETRY
+    if (OCR1A < TCNT1 + 16 && telemetry.isr_overruns < 0xFFFF)
+      ++telemetry.isr_overruns;
+#endif
     OCR1A = max(OCR1A, TCNT1 + 16);
 #endif
 
     // If current block is finished, reset pointer
     if (step_events_completed >= current_block->step_event_count) {
+#ifdef EVENT_TRACE
+      trace_event(TRACE_BLOCK_END, block_buffer_tail);
+#endif
       current_block = NULL;
       plan_discard_current_block();
     }
   }
 }
 
+#ifdef ENDSTOP_INTERRUPTS_FEATURE
+  #ifdef COREXY
+    #error ENDSTOP_INTERRUPTS_FEATURE not implemented for COREXY yet.
+  #endif
+
+// ATmega2560 pins with a pin change interrupt (Arduino pin numbering)
+#define PIN_HAS_PCINT(p) ((((p) >= 10) && ((p) <= 13)) || (((p) >= 50) && ((p) <= 53)) || (((p) >= 62) && ((p) <= 69)))
+
+#if !PIN_HAS_PCINT(X_MIN_PIN) && !PIN_HAS_PCINT(X_MAX_PIN) && !PIN_HAS_PCINT(Y_MIN_PIN) && !PIN_HAS_PCINT(Y_MAX_PIN) \
+  && !PIN_HAS_PCINT(Z_MIN_PIN) && !PIN_HAS_PCINT(Z_MAX_PIN)
+  #error ENDSTOP_INTERRUPTS_FEATURE needs an endstop on a pin change interrupt pin, the Ultimaker2 endstops have none.
+#endif
+
+static void endstop_attach_interrupt(const uint8_t pin, const uint8_t endstop)
+{
+  if (!PIN_HAS_PCINT(pin))
+    return; // keep polling this endstop in the stepper ISR
+
+  if (digitalPinToPCICRbit(pin) == 2)
+    PCMSK2 |= _BV(digitalPinToPCMSKbit(pin));
+  else
+    PCMSK0 |= _BV(digitalPinToPCMSKbit(pin));
+  PCICR |= _BV(digitalPinToPCICRbit(pin));
+  endstop_irq_pins |= _BV(endstop);
+}
+
+static void endstop_init_interrupts()
+{
+  #if defined(X_MIN_PIN) && X_MIN_PIN > -1
+    endstop_attach_interrupt(X_MIN_PIN, ENDSTOP_X_MIN);
+  #endif
+  #if defined(X_MAX_PIN) && X_MAX_PIN > -1
+    endstop_attach_interrupt(X_MAX_PIN, ENDSTOP_X_MAX);
+  #endif
+  #if defined(Y_MIN_PIN) && Y_MIN_PIN > -1
+    endstop_attach_interrupt(Y_MIN_PIN, ENDSTOP_Y_MIN);
+  #endif
+  #if defined(Y_MAX_PIN) && Y_MAX_PIN > -1
+    endstop_attach_interrupt(Y_MAX_PIN, ENDSTOP_Y_MAX);
+  #endif
+  #if defined(Z_MIN_PIN) && Z_MIN_PIN > -1
+    endstop_attach_interrupt(Z_MIN_PIN, ENDSTOP_Z_MIN);
+  #endif
+  #if defined(Z_MAX_PIN) && Z_MAX_PIN > -1
+    endstop_attach_interrupt(Z_MAX_PIN, ENDSTOP_Z_MAX);
+  #endif
+}
+
+#define ENDSTOP_IRQ_SAMPLE(endstop, PIN, INVERTING, AXIS, steps) \
+  if ((endstop_irq_pins & _BV(endstop)) && !(endstop_irq_pending & _BV(endstop)) && (READ(PIN) != INVERTING) && (current_block->steps > 0)) { \
+    endstop_irq_steps[AXIS] = count_position[AXIS]; \
+    endstop_irq_pending |= _BV(endstop); }
+
+// Called on a pin change, when a block is taken and when the endstops are enabled: an edge that came before
+// is not seen by the pin change interrupt. The stepper ISR cannot interrupt this, so count_position is exact.
+static void endstop_isr()
+{
+  if (!check_endstops || current_block == NULL)
+    return;
+
+  if ((out_bits & (1<<X_AXIS)) != 0) {   // stepping along -X axis
+    #if defined(X_MIN_PIN) && X_MIN_PIN > -1
+      ENDSTOP_IRQ_SAMPLE(ENDSTOP_X_MIN, X_MIN_PIN, X_ENDSTOPS_INVERTING, X_AXIS, steps_x)
+    #endif
+  }
+  else {
+    #if defined(X_MAX_PIN) && X_MAX_PIN > -1
+      ENDSTOP_IRQ_SAMPLE(ENDSTOP_X_MAX, X_MAX_PIN, X_ENDSTOPS_INVERTING, X_AXIS, steps_x)
+    #endif
+  }
+
+  if ((out_bits & (1<<Y_AXIS)) != 0) {   // -direction
+    #if defined(Y_MIN_PIN) && Y_MIN_PIN > -1
+      ENDSTOP_IRQ_SAMPLE(ENDSTOP_Y_MIN, Y_MIN_PIN, Y_ENDSTOPS_INVERTING, Y_AXIS, steps_y)
+    #endif
+  }
+  else {
+    #if defined(Y_MAX_PIN) && Y_MAX_PIN > -1
+      ENDSTOP_IRQ_SAMPLE(ENDSTOP_Y_MAX, Y_MAX_PIN, Y_ENDSTOPS_INVERTING, Y_AXIS, steps_y)
+    #endif
+  }
+
+  if ((out_bits & (1<<Z_AXIS)) != 0) {   // -direction
+    #if defined(Z_MIN_PIN) && Z_MIN_PIN > -1
+      ENDSTOP_IRQ_SAMPLE(ENDSTOP_Z_MIN, Z_MIN_PIN, Z_ENDSTOPS_INVERTING, Z_AXIS, steps_z)
+    #endif
+  }
+  else {
+    #if defined(Z_MAX_PIN) && Z_MAX_PIN > -1
+      ENDSTOP_IRQ_SAMPLE(ENDSTOP_Z_MAX, Z_MAX_PIN, Z_ENDSTOPS_INVERTING, Z_AXIS, steps_z)
+    #endif
+  }
+}
+
+// Second sample of a pending endstop, from the stepper ISR: latch the step count of the first sample and end the block.
+#define ENDSTOP_IRQ_CONFIRM(pending, endstop, PIN, INVERTING, AXIS, hit_flag) \
+  if ((pending & _BV(endstop)) && (READ(PIN) != INVERTING)) { \
+    endstops_trigsteps[AXIS] = endstop_irq_steps[AXIS]; \
+    hit_flag = true; \
+    step_events_completed = current_block->step_event_count; }
+
+static void endstop_irq_confirm()
+{
+  uint8_t pending = endstop_irq_pending;
+  endstop_irq_pending = 0;
+  if (!check_endstops)
+    return;
+
+  #if defined(X_MIN_PIN) && X_MIN_PIN > -1
+    ENDSTOP_IRQ_CONFIRM(pending, ENDSTOP_X_MIN, X_MIN_PIN, X_ENDSTOPS_INVERTING, X_AXIS, endstop_x_hit)
+  #endif
+  #if defined(X_MAX_PIN) && X_MAX_PIN > -1
+    ENDSTOP_IRQ_CONFIRM(pending, ENDSTOP_X_MAX, X_MAX_PIN, X_ENDSTOPS_INVERTING, X_AXIS, endstop_x_hit)
+  #endif
+  #if defined(Y_MIN_PIN) && Y_MIN_PIN > -1
+    ENDSTOP_IRQ_CONFIRM(pending, ENDSTOP_Y_MIN, Y_MIN_PIN, Y_ENDSTOPS_INVERTING, Y_AXIS, endstop_y_hit)
+  #endif
+  #if defined(Y_MAX_PIN) && Y_MAX_PIN > -1
+    ENDSTOP_IRQ_CONFIRM(pending, ENDSTOP_Y_MAX, Y_MAX_PIN, Y_ENDSTOPS_INVERTING, Y_AXIS, endstop_y_hit)
+  #endif
+  #if defined(Z_MIN_PIN) && Z_MIN_PIN > -1
+    ENDSTOP_IRQ_CONFIRM(pending, ENDSTOP_Z_MIN, Z_MIN_PIN, Z_ENDSTOPS_INVERTING, Z_AXIS, endstop_z_hit)
+  #endif
+  #if defined(Z_MAX_PIN) && Z_MAX_PIN > -1
+    ENDSTOP_IRQ_CONFIRM(pending, ENDSTOP_Z_MAX, Z_MAX_PIN, Z_ENDSTOPS_INVERTING, Z_AXIS, endstop_z_hit)
+  #endif
+}
+
+ISR(PCINT0_vect)
+{
+  endstop_isr();
+}
+
+ISR(PCINT2_vect)
+{
+  endstop_isr();
+}
+#endif // ENDSTOP_INTERRUPTS_FEATURE
+
 #ifdef ADVANCE
   unsigned char old_OCR0A;
   // Timer interrupt for E. e_steps is set in the main routine;
@@ -982,8 +1130,7 @@ void st_init()
   // Set the timer pre-scaler
   // Generally we use a divider of 8, resulting in a 2MHz timer
   // frequency on a 16MHz MCU. If you are going to change this, be
-  // sure to regenerate speed_lookuptable.h with
-  // create_speed_lookuptable.py
+  // sure to update SPEED_TIMER_FREQ in speed_lookuptable.h
   TCCR1B = (TCCR1B & ~(0x07<<CS10)) | (2<<CS10);
 
   // Init Stepper ISR to 122 Hz for quick starting
@@ -1002,6 +1149,10 @@ void st_init()
     TIMSK0 |= (1<<OCIE0A);
   #endif //ADVANCE
 
+  #ifdef ENDSTOP_INTERRUPTS_FEATURE
+    endstop_init_interrupts();
+  #endif
+
   enable_endstops(true); // Start with endstops active. After homing they can be disabled
   sei();
 }
@@ -1084,9 +1235,28 @@ void quickStop()
 
 #if defined(BABYSTEPPING)
 
-// MUST ONLY BE CALLED BY AN ISR,
-// No other ISR should ever interrupt this!
-void babystep(const uint8_t axis, const bool direction)
+void babystep_add(const uint8_t axis, const int16_t steps)
+{
+  if (axis > Z_AXIS)
+    return;
+  CRITICAL_SECTION_START
+  babystepsTodo[axis] += steps;
+  CRITICAL_SECTION_END
+  st_wake_up();
+}
+
+int16_t babystep_pending(const uint8_t axis)
+{
+  CRITICAL_SECTION_START
+  int16_t pending = babystepsTodo[axis];
+  CRITICAL_SECTION_END
+  return pending;
+}
+
+// perform a short step with a single stepper motor, outside of any convention
+// MUST ONLY BE CALLED BY THE STEPPER ISR,
+// so it never interferes with the direction and step pins of a running block.
+static void babystep(const uint8_t axis, const bool direction)
 {
   switch(axis)
   {
@@ -1218,6 +1388,36 @@ void babystep(const uint8_t axis, const bool direction)
   default:    break;
   }
 }
+
+// Executes at most one queued babystep per axis and at most one every BABYSTEP_MIN_INTERVAL.
+// Called at the start of the stepper ISR, between the regular step pulses.
+static FORCE_INLINE void babystep_isr()
+{
+  if (babystep_ticks < BABYSTEP_TICKS)
+  {
+    // saturating add of the elapsed timer period
+    uint16_t period = OCR1A;
+    babystep_ticks = (period < BABYSTEP_TICKS - babystep_ticks) ? babystep_ticks + period : BABYSTEP_TICKS;
+    return;
+  }
+  for(uint8_t axis=0; axis<3; ++axis)
+  {
+    int16_t curTodo=babystepsTodo[axis]; //get rid of volatile for performance
+
+    if(curTodo>0)
+    {
+      babystep(axis,/*fwd*/true);
+      babystepsTodo[axis] = curTodo - 1; //less to do next time
+      babystep_ticks = 0;
+    }
+    else if(curTodo<0)
+    {
+      babystep(axis,/*fwd*/false);
+      babystepsTodo[axis] = curTodo + 1; //less to do next time
+      babystep_ticks = 0;
+    }
+  }
+}
 #endif //BABYSTEPPING
 
 void digitalPotWrite(int address, int value) // From Arduino DigitalPotControl example
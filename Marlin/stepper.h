@@ -87,7 +87,10 @@ void microstep_readings();
 #endif
 
 #if defined(BABYSTEPPING)
-  void babystep(const uint8_t axis,const bool direction); // perform a short step with a single stepper motor, outside of any convention
+  // queue babysteps for an axis, they are executed by the stepper interrupt at a limited rate
+  void babystep_add(const uint8_t axis, const int16_t steps);
+  // number of babysteps that are still waiting for execution
+  int16_t babystep_pending(const uint8_t axis);
 #endif
 
 #endif
@@ -0,0 +1,98 @@
+#include "Marlin.h"
+#include "telemetry.h"
+
+#ifdef LOOP_TELEMETRY
+
+loop_telemetry_t telemetry;
+
+// add microseconds to a millisecond counter, the remainder is kept in us
+static void add_time(unsigned long &ms, uint16_t &us, unsigned long add)
+{
+  add += us;
+  ms += add / 1000;
+  us = add % 1000;
+}
+
+void telemetry_loop(uint8_t queued)
+{
+  unsigned long now = micros();
+  if (telemetry.loops)
+  {
+    unsigned long period = now - telemetry.loop_start;
+    if (period > telemetry.loop_max_us)
+      telemetry.loop_max_us = period;
+    if (period < telemetry.loop_min_us)
+      telemetry.loop_min_us = period;
+  }
+  telemetry.loop_start = now;
+  ++telemetry.loops;
+
+  if (queued > BUFSIZE)
+    queued = BUFSIZE;
+  if (++telemetry.queue[queued] == 0xFFFF)
+  {
+    for (uint8_t i = 0; i <= BUFSIZE; ++i)
+      telemetry.queue[i] >>= 1;
+  }
+}
+
+void telemetry_idle(bool starving)
+{
+  unsigned long now = micros();
+  if (starving)
+    add_time(telemetry.starved_ms, telemetry.starved_us, now - telemetry.idle_last);
+  telemetry.idle_last = now;
+}
+
+void telemetry_sd_read(unsigned long us)
+{
+  ++telemetry.sd_reads;
+  add_time(telemetry.sd_stall_ms, telemetry.sd_stall_us, us);
+  if (us > telemetry.sd_stall_max_us)
+    telemetry.sd_stall_max_us = min(us, 0xFFFFUL);
+}
+
+void telemetry_print()
+{
+  unsigned long samples = 0;
+  for (uint8_t i = 0; i <= BUFSIZE; ++i)
+    samples += telemetry.queue[i];
+
+  SERIAL_PROTOCOLPGM("loop min:");
+  SERIAL_PROTOCOL(telemetry.loops > 1 ? telemetry.loop_min_us : 0);
+  SERIAL_PROTOCOLPGM(" avg:");
+  SERIAL_PROTOCOL(telemetry.loops ? (unsigned long)((millis() - telemetry.since) * 1000.0 / telemetry.loops) : 0);
+  SERIAL_PROTOCOLPGM(" max:");
+  SERIAL_PROTOCOL(telemetry.loop_max_us);
+  SERIAL_PROTOCOLPGM(" queue:");
+  for (uint8_t i = 0; i <= BUFSIZE; ++i)
+  {
+    if (i)
+      SERIAL_PROTOCOLPGM("/");
+    SERIAL_PROTOCOL(samples ? (unsigned int)((telemetry.queue[i] * 100UL + samples / 2) / samples) : 0);
+  }
+  SERIAL_PROTOCOLPGM(" starved:");
+  SERIAL_PROTOCOL(telemetry.starved_ms);
+  SERIAL_PROTOCOLPGM(" sd:");
+  SERIAL_PROTOCOL(telemetry.sd_reads);
+  SERIAL_PROTOCOLPGM(" stall:");
+  SERIAL_PROTOCOL(telemetry.sd_stall_ms);
+  SERIAL_PROTOCOLPGM(" max:");
+  SERIAL_PROTOCOL(telemetry.sd_stall_max_us);
+  SERIAL_PROTOCOLPGM(" rx:");
+  SERIAL_PROTOCOL(telemetry.rx_overflows);
+  SERIAL_PROTOCOLPGM(" isr:");
+  SERIAL_PROTOCOLLN(telemetry.isr_overruns);
+}
+
+void telemetry_reset()
+{
+  CRITICAL_SECTION_START;
+  memset(&telemetry, 0, sizeof(telemetry));
+  CRITICAL_SECTION_END;
+  telemetry.loop_min_us = 0xFFFF;
+  telemetry.idle_last = micros();
+  telemetry.since = millis();
+}
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+#include "Configuration.h"
+
+#ifdef LOOP_TELEMETRY
+
+struct loop_telemetry_t {
+  unsigned long loops;
+  unsigned long loop_start;       // micros() of the last main loop pass
+  unsigned long loop_max_us;
+  uint16_t loop_min_us;
+  uint16_t queue[BUFSIZE + 1];    // main loop passes per command buffer depth, halved when one saturates
+  unsigned long idle_last;        // micros() of the last idle() call
+  unsigned long starved_ms;       // nothing moving although commands or the SD file are waiting
+  uint16_t starved_us;
+  unsigned long sd_reads;         // blocks read for the printed file
+  unsigned long sd_stall_ms;
+  uint16_t sd_stall_us;
+  uint16_t sd_stall_max_us;
+  volatile uint16_t rx_overflows; // characters lost because the serial receive buffer was full
+  volatile uint16_t isr_overruns; // stepper interrupts that ended after their next compare time
+  unsigned long since;            // millis() of the last reset
+};
+
+extern loop_telemetry_t telemetry;
+
+// once per main loop pass, with the number of commands in the command buffer
+void telemetry_loop(uint8_t queued);
+// from idle(), starving tells if the planner is empty while there is something to print
+void telemetry_idle(bool starving);
+void telemetry_sd_read(unsigned long us);
+// M47: "loop min:<us> avg:<us> max:<us> queue:<% per depth> starved:<ms> sd:<blocks> stall:<ms> max:<us> rx:<lost> isr:<overruns>"
+void telemetry_print();
+void telemetry_reset();
+
+#endif
+#endif //TELEMETRY_H
@@ -38,6 +38,7 @@
 #include "preferences.h"
 #include "tinkergnome.h"
 #include "powerbudget.h"
+#include "trace.h"
 
 #define HEATER_TIMEOUT_1   (1000L * 30L)   //  30 seconds
 #define HEATER_TIMEOUT_2   (1000L * 90L)   //  90 seconds
@@ -82,10 +83,6 @@ float current_temperature_bed = 0.0;
   unsigned char fanSpeedSoftPwm;
 #endif
 
-#if defined(BABYSTEPPING)
-  volatile int babystepsTodo[3]={0,0,0};
-#endif
-
 unsigned long extruder_lastused[EXTRUDERS];
 
 //===========================================================================
@@ -126,6 +123,9 @@ static volatile bool temp_meas_ready = false;
 #endif
   static unsigned char soft_pwm_bed;
   static unsigned char soft_pwm[EXTRUDERS];
+#ifdef EVENT_TRACE
+  static unsigned char traced_pwm[EXTRUDERS + 1];
+#endif
 #if defined(FAN_SOFT_PWM) || defined(FAN2_SOFT_PWM)
   static unsigned char soft_pwm_fan;
 #endif
@@ -481,6 +481,18 @@ static unsigned char limit_power(uint16_t wattage, unsigned char pwm, uint16_t &
     return pwm;
 }
 
+#ifdef EVENT_TRACE
+// record the PWM of heater (EXTRUDERS is the bed) when it changed since the last call
+static void trace_heater(uint8_t heater, unsigned char pwm)
+{
+  if (pwm != traced_pwm[heater])
+  {
+    traced_pwm[heater] = pwm;
+    trace_event(TRACE_HEATER + heater, pwm);
+  }
+}
+#endif
+
 void manage_heater()
 {
   if(temp_meas_ready != true)   //better readability
@@ -628,6 +640,9 @@ void manage_heater()
     else {
       soft_pwm[e] = 0;
     }
+#ifdef EVENT_TRACE
+    trace_heater(e, soft_pwm[e]);
+#endif
 
     #ifdef WATCH_TEMP_PERIOD
     if(watchmillis[e] && millis() - watchmillis[e] > WATCH_TEMP_PERIOD)
@@ -803,6 +818,9 @@ void manage_heater()
       }
     #endif
   }
+#ifdef EVENT_TRACE
+  trace_heater(EXTRUDERS, soft_pwm_bed);
+#endif
   #endif
 }
 
@@ -1556,23 +1574,6 @@ ISR(TIMER0_COMPB_vect)
     }
 #endif
   }
-#if defined(BABYSTEPPING)
-  for(uint8_t axis=0; axis<3; ++axis)
-  {
-    int curTodo=babystepsTodo[axis]; //get rid of volatile for performance
-
-    if(curTodo>0)
-    {
-      babystep(axis,/*fwd*/true);
-      --babystepsTodo[axis]; //less to do next time
-    }
-    else if(curTodo<0)
-    {
-      babystep(axis,/*fwd*/false);
-      ++babystepsTodo[axis]; //less to do next time
-    }
-  }
-#endif //BABYSTEPPING
 
 }
 
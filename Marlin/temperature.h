@@ -68,10 +68,6 @@ extern float current_temperature_bed;
   extern float bedKp,bedKi,bedKd;
 #endif
 
-#if defined(BABYSTEPPING)
-  extern volatile int babystepsTodo[3];
-#endif
-
 //high level conversion routines, for use outside of temperature.cpp
 //inline so that there is no performance decrease.
 //deg=degreeCelsius
@@ -4,6 +4,7 @@
 #include "Marlin.h"
 #include "cardreader.h"
 #include "temperature.h"
+#include "stepper.h"
 #include "lifetime_stats.h"
 #include "ConfigurationStore.h"
 #include "machinesettings.h"
@@ -11,6 +12,7 @@
 #include "preferences.h"
 #include "commandbuffer.h"
 #include "powerbudget.h"
+#include "print_journal.h"
 #include "UltiLCD2_low_lib.h"
 #include "UltiLCD2_hi_lib.h"
 #include "UltiLCD2.h"
@@ -55,8 +57,6 @@ static void init_babystepping();
 static void lcd_menu_babystepping();
 #endif // BABYSTEPPING
 
-static void lcd_print_tune_speed();
-static void lcd_print_tune_fan();
 static void lcd_print_flow_nozzle0();
 #if EXTRUDERS > 1
 static void lcd_print_flow_nozzle1();
@@ -229,39 +229,18 @@ void menu_printing_init()
     printing_page = 0;
 }
 
-// return heatup menu option
-static const menu_t & get_heatup_menuoption(uint8_t nr, menu_t &opt)
-{
-    uint8_t menu_index = 0;
-    if (nr == menu_index++)
-    {
-        opt.setData(MENU_NORMAL, lcd_print_tune);
-    }
-    else if (nr == menu_index++)
-    {
-        opt.setData(MENU_NORMAL, lcd_print_abort);
-    }
-    else if (nr == menu_index++)
-    {
-        // temp nozzle 1
-        opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_nozzle0_diff);
-    }
+// heatup menu options
+static const menu_item_t heatup_menu[] PROGMEM = {
+    MENU_ACTION(lcd_print_tune, 0),
+    MENU_ACTION(lcd_print_abort, 0),
+    MENU_EDIT(lcd_print_tune_nozzle0_diff, 0, 0),
 #if EXTRUDERS > 1
-    else if (nr == menu_index++)
-    {
-        // temp nozzle 2
-        opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_nozzle1_diff);
-    }
+    MENU_EDIT(lcd_print_tune_nozzle1_diff, 0, 0),
 #endif
 #if TEMP_SENSOR_BED != 0
-    else if (nr == menu_index++)
-    {
-        // temp buildplate
-        opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_bed_diff);
-    }
+    MENU_EDIT(lcd_print_tune_bed_diff, 0, 0),
 #endif
-    return opt;
-}
+};
 
 static void lcd_print_ask_pause()
 {
@@ -287,136 +266,55 @@ static void lcd_toggle_led()
 }
 #endif
 
-// return print menu option
-static const menu_t & get_print_menuoption(uint8_t nr, menu_t &opt)
+static void lcd_print_pause_or_tune()
 {
-    uint8_t menu_index = 0;
-    if (printing_page == 1)
+    if (IS_SD_PRINTING)
     {
-        if (nr == menu_index++)
-        {
-            opt.setData(MENU_NORMAL, lcd_menu_print_page_dec);
-        }
-        else if (nr == menu_index++)
-        {
-//            opt.setData(MENU_NORMAL, lcd_print_ask_pause);
-            if (IS_SD_PRINTING)
-            {
-                opt.setData(MENU_NORMAL, lcd_print_ask_pause);
-            }
-            else
-            {
-                opt.setData(MENU_NORMAL, lcd_print_tune);
-
-            }
-        }
-#if FAN2_PIN != LED_PIN
-        else if (nr == menu_index++)
-        {
-            opt.setData(MENU_NORMAL, lcd_toggle_led);
-        }
-#endif
-        else if (nr == menu_index++)
-        {
-            opt.setData(MENU_INPLACE_EDIT, lcd_tune_retract_length, 2);
-        }
-        else if (nr == menu_index++)
-        {
-            opt.setData(MENU_INPLACE_EDIT, lcd_tune_retract_speed);
-        }
-        else if (nr == menu_index++)
-        {
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_accel);
-        }
-        else if (nr == menu_index++)
-        {
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_xyjerk);
-        }
+        lcd_print_ask_pause();
     }
     else
     {
-        if (nr == menu_index++)
+        lcd_print_tune();
+    }
+}
+
+// print menu options, first page
+static const menu_item_t print_menu[] PROGMEM = {
 #if FAN2_PIN != LED_PIN
-        {
-            opt.setData(MENU_NORMAL, lcd_toggle_led);
-        }
-        else if (nr == menu_index++)
+    MENU_ACTION(lcd_toggle_led, 0),
 #endif
-        {
-            if (IS_SD_PRINTING)
-            {
-                opt.setData(MENU_NORMAL, lcd_print_ask_pause);
-            }
-            else
-            {
-                opt.setData(MENU_NORMAL, lcd_print_tune);
-            }
-        }
-        else if (nr == menu_index++)
-        {
-            opt.setData(MENU_NORMAL, lcd_menu_print_page_inc);
-        }
+    MENU_ACTION(lcd_print_pause_or_tune, 0),
+    MENU_ACTION(lcd_menu_print_page_inc, 0),
 #if defined(BABYSTEPPING)
-        else if (nr == menu_index++)
-        {
-            // babystepping menu
-            opt.setData(MENU_NORMAL, lcd_start_babystepping);
-        }
+    MENU_ACTION(lcd_start_babystepping, 0),
 #endif
-        else if (nr == menu_index++)
-        {
-            // flow nozzle 1
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_flow_nozzle0);
-        }
-    #if EXTRUDERS > 1
-        else if (nr == menu_index++)
-        {
-            // flow nozzle 2
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_flow_nozzle1);
-        }
-    #endif
-        else if (nr == menu_index++)
-        {
-            // speed
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_speed);
-        }
-        else if (nr == menu_index++)
-        {
-            // temp nozzle 1
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_nozzle0_diff);
-        }
-    #if EXTRUDERS > 1
-        else if (nr == menu_index++)
-        {
-            // temp nozzle 2
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_nozzle1_diff);
-        }
-    #endif
-        else if (nr == menu_index++)
-        {
-            // fan
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_fan);
-        }
-    #if TEMP_SENSOR_BED != 0
-        else if (nr == menu_index++)
-        {
-            // temp buildplate
-            opt.setData(MENU_INPLACE_EDIT, lcd_print_tune_bed_diff);
-        }
-    #endif
-    }
-    return opt;
-}
-
-static void lcd_print_tune_speed()
-{
-    lcd_tune_value(feedmultiply, 0, 999);
-}
+    MENU_EDIT(lcd_print_flow_nozzle0, 0, 0),
+#if EXTRUDERS > 1
+    MENU_EDIT(lcd_print_flow_nozzle1, 0, 0),
+#endif
+    MENU_VALUE(MENU_ITEM_INT, feedmultiply, 0, 999, 0, 0),
+    MENU_EDIT(lcd_print_tune_nozzle0_diff, 0, 0),
+#if EXTRUDERS > 1
+    MENU_EDIT(lcd_print_tune_nozzle1_diff, 0, 0),
+#endif
+    MENU_VALUE(MENU_ITEM_PERCENT, fanSpeed, 0, 100, 0, 0),
+#if TEMP_SENSOR_BED != 0
+    MENU_EDIT(lcd_print_tune_bed_diff, 0, 0),
+#endif
+};
 
-static void lcd_print_tune_fan()
-{
-    lcd_tune_byte(fanSpeed, 0, 100);
-}
+// print menu options, second page
+static const menu_item_t print_menu_page2[] PROGMEM = {
+    MENU_ACTION(lcd_menu_print_page_dec, 0),
+    MENU_ACTION(lcd_print_pause_or_tune, 0),
+#if FAN2_PIN != LED_PIN
+    MENU_ACTION(lcd_toggle_led, 0),
+#endif
+    MENU_EDIT(lcd_tune_retract_length, 2, 0),
+    MENU_EDIT(lcd_tune_retract_speed, 0, 0),
+    MENU_EDIT(lcd_print_tune_accel, 0, 0),
+    MENU_EDIT(lcd_print_tune_xyjerk, 0, 0),
+};
 
 static void lcd_print_flow_nozzle0()
 {
@@ -470,7 +368,7 @@ static void _lcd_babystep(const uint8_t axis)
     if (diff)
     {
         FLOAT_SETTING(axis) += (float)diff/axis_steps_per_unit[axis];
-        babystepsTodo[axis] += diff;
+        babystep_add(axis, diff);
         lcd_lib_encoder_pos = 0;
     }
 }
@@ -1329,10 +1227,10 @@ void lcd_menu_print_heatup_tg()
     lcd_lib_draw_string_right(LCD_GFX_WIDTH-LCD_CHAR_MARGIN_RIGHT-34, ypos, buffer);
     lcd_lib_draw_heater(LCD_GFX_WIDTH-LCD_CHAR_MARGIN_RIGHT-70, ypos, getHeaterPower(0));
 
-    menu.process_submenu(get_heatup_menuoption, EXTRUDERS + BED_MENU_OFFSET + 2);
+    menu.process_submenu_P(heatup_menu, COUNT(heatup_menu));
 
     uint8_t flags = 0;
-    for (uint8_t index=0; index<EXTRUDERS + BED_MENU_OFFSET + 2; ++index)
+    for (uint8_t index=0; index<COUNT(heatup_menu); ++index)
     {
         menu.drawSubMenu(drawHeatupSubmenu, index, flags);
     }
@@ -1525,20 +1423,15 @@ void lcd_menu_printing_tg()
 
         uint8_t index = 0;
 
-#ifdef BABYSTEPPING
-  #define BABYSTEPPING_MENU_OFFSET 1
-#else
-  #define BABYSTEPPING_MENU_OFFSET 0
-#endif
 #if FAN2_PIN == LED_PIN
   #define LED_MENU_OFFSET 0
 #else
   #define LED_MENU_OFFSET 1
 #endif
 
-        uint8_t len = (printing_page == 1) ? 6 + LED_MENU_OFFSET : EXTRUDERS*2 + BED_MENU_OFFSET + BABYSTEPPING_MENU_OFFSET + LED_MENU_OFFSET + 4;
+        uint8_t len = (printing_page == 1) ? COUNT(print_menu_page2) : COUNT(print_menu);
 
-        menu.process_submenu(get_print_menuoption, len);
+        menu.process_submenu_P((printing_page == 1) ? print_menu_page2 : print_menu, len);
         const char *message = lcd_getstatus();
         if (!menu.isSubmenuSelected())
         {
@@ -1924,6 +1817,10 @@ static void lcd_recover_start()
     current_position[E_AXIS] = 0.0f;
     plan_set_e_position(current_position[E_AXIS], active_extruder, true);
     menu.replace_menu(menu_t(lcd_menu_recover_file));
+#ifdef SEEK_LAYER_SUPPORT
+    // skip the part that was printed already, if the journal or the layer index knows where it ends
+    seek_layer(recover_height);
+#endif
     card.startFileprint();
 }
 
@@ -2017,6 +1914,43 @@ void lcd_menu_recover_init()
     menu.set_active(get_recover_menuoption, 2);
 }
 
+#ifdef POWER_LOSS_JOURNAL
+static void recover_journal_start()
+{
+    const journal_record_t &record = journal_last();
+    recover_height = record.position[Z_AXIS];
+    for (uint8_t e=0; e<EXTRUDERS; ++e)
+    {
+        recover_temperature[e] = record.temperature[e];
+    }
+    printing_state = PRINT_STATE_RECOVER;
+    // select file, the journal is used when the interrupted file is printed from the journaled height
+    lcd_clear_cache();
+    card.release();
+    card.setroot();
+    menu.replace_menu(menu_t(lcd_menu_print_select, SCROLL_MENU_ITEM_POS(0)));
+}
+
+static void recover_journal_discard()
+{
+    journal_stop();
+    menu.return_to_previous();
+}
+
+void lcd_menu_recover_journal()
+{
+    char buffer[32] = {0};
+    lcd_question_screen(NULL, recover_journal_start, PSTR("RECOVER"), NULL, recover_journal_discard, PSTR("DISCARD"));
+
+    lcd_lib_draw_string_centerP(10, PSTR("Print interrupted"));
+    lcd_lib_draw_string_center(20, journal_name());
+    strcpy_P(buffer, PSTR("at Z "));
+    float_to_string2(journal_last().position[Z_AXIS], buffer + 5, PSTR("mm"));
+    lcd_lib_draw_string_center(30, buffer);
+    lcd_lib_update_screen();
+}
+#endif
+
 void lcd_menu_expert_recover()
 {
     lcd_basic_screen();
@@ -2291,67 +2225,20 @@ static void pos2string(uint8_t flags, uint8_t axis, char *buffer)
     float_to_string2((flags & MENU_ACTIVE) ? TARGET_POS(axis) : st_get_position(axis) / axis_steps_per_unit[axis], buffer, PSTR("mm"));
 }
 
-// create menu options for "move axes"
-static const menu_t & get_move_menuoption(uint8_t nr, menu_t &opt)
-{
-    uint8_t index(0);
-    if (nr == index++)
-    {
-        // Home all axis
-        opt.setData(MENU_NORMAL, CommandBuffer::homeAll);
-    }
-    else if (nr == index++)
-    {
-        // RETURN
-        opt.setData(MENU_NORMAL, lcd_change_to_previous_menu);
-    }
-    else if (nr == index++)
-    {
-        // x move
-        opt.setData(MENU_INPLACE_EDIT, init_target_positions, lcd_move_x_axis, stopMove, 2);
-    }
-    else if (nr == index++)
-    {
-        // x position
-        opt.setData(MENU_INPLACE_EDIT, init_target_positions, lcd_position_x_axis, NULL, 4);
-    }
-    else if (nr == index++)
-    {
-        // x home
-        opt.setData(MENU_NORMAL, lcd_home_x_axis);
-    }
-    else if (nr == index++)
-    {
-        // y move
-        opt.setData(MENU_INPLACE_EDIT, init_target_positions, lcd_move_y_axis, stopMove, 2);
-    }
-    else if (nr == index++)
-    {
-        // y position
-        opt.setData(MENU_INPLACE_EDIT, init_target_positions, lcd_position_y_axis, NULL, 4);
-    }
-    else if (nr == index++)
-    {
-        // y home
-        opt.setData(MENU_NORMAL, lcd_home_y_axis);
-    }
-    else if (nr == index++)
-    {
-        // z move
-        opt.setData(MENU_INPLACE_EDIT, init_target_positions, lcd_move_z_axis, stopMove, 2);
-    }
-    else if (nr == index++)
-    {
-        // z position
-        opt.setData(MENU_INPLACE_EDIT, init_target_positions, lcd_position_z_axis, NULL, 5);
-    }
-    else if (nr == index++)
-    {
-        // z home
-        opt.setData(MENU_NORMAL, CommandBuffer::homeBed);
-    }
-    return opt;
-}
+// menu options for "move axes"
+static const menu_item_t move_menu[] PROGMEM = {
+    MENU_ACTION(CommandBuffer::homeAll, 0),
+    MENU_ACTION(lcd_change_to_previous_menu, 0),
+    MENU_EDIT_INIT(init_target_positions, lcd_move_x_axis, stopMove, 2, 0),
+    MENU_EDIT_INIT(init_target_positions, lcd_position_x_axis, 0, 4, 0),
+    MENU_ACTION(lcd_home_x_axis, 0),
+    MENU_EDIT_INIT(init_target_positions, lcd_move_y_axis, stopMove, 2, 0),
+    MENU_EDIT_INIT(init_target_positions, lcd_position_y_axis, 0, 4, 0),
+    MENU_ACTION(lcd_home_y_axis, 0),
+    MENU_EDIT_INIT(init_target_positions, lcd_move_z_axis, stopMove, 2, 0),
+    MENU_EDIT_INIT(init_target_positions, lcd_position_z_axis, 0, 5, 0),
+    MENU_ACTION(CommandBuffer::homeBed, 0),
+};
 
 static void drawMoveSubmenu(uint8_t nr, uint8_t &flags)
 {
@@ -2589,10 +2476,10 @@ void lcd_menu_move_axes()
     lcd_basic_screen();
     lcd_lib_draw_hline(3, 124, 13);
 
-    menu.process_submenu(get_move_menuoption, 11);
+    menu.process_submenu_P(move_menu, COUNT(move_menu));
 
     uint8_t flags = 0;
-    for (uint8_t index=0; index<11; ++index) {
+    for (uint8_t index=0; index<COUNT(move_menu); ++index) {
         menu.drawSubMenu(drawMoveSubmenu, index, flags);
     }
     if (!(flags & MENU_STATUSLINE))
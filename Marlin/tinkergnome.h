@@ -33,6 +33,9 @@ void lcd_menu_expert_extrude();
 void recover_start_print(const char *cmd);
 void lcd_menu_recover_init();
 void lcd_menu_expert_recover();
+#ifdef POWER_LOSS_JOURNAL
+void lcd_menu_recover_journal();
+#endif
 void reset_printing_state();
 void endofprint_retract_store();
 void lcd_prepare_buildplate_adjust();
@@ -0,0 +1,59 @@
+#include "Marlin.h"
+#include "trace.h"
+
+#ifdef EVENT_TRACE
+
+#define TRACE_MASK (TRACE_BUFFER_SIZE - 1)
+
+static trace_event_t trace_buffer[TRACE_BUFFER_SIZE];
+static uint8_t trace_head;
+static uint8_t trace_count;
+
+void trace_event(uint8_t type, uint8_t arg)
+{
+  CRITICAL_SECTION_START;
+  trace_event_t &event = trace_buffer[trace_head];
+  event.time = micros();
+  event.type = type;
+  event.arg = arg;
+  trace_head = (trace_head + 1) & TRACE_MASK;
+  if (trace_count < TRACE_BUFFER_SIZE)
+    ++trace_count;
+  CRITICAL_SECTION_END;
+}
+
+bool trace_take(trace_event_t &event)
+{
+  bool taken = false;
+  CRITICAL_SECTION_START;
+  if (trace_count)
+  {
+    event = trace_buffer[(trace_head - trace_count) & TRACE_MASK];
+    --trace_count;
+    taken = true;
+  }
+  CRITICAL_SECTION_END;
+  return taken;
+}
+
+void trace_dump()
+{
+  // new events may replace old ones while sending, so the count is fixed first
+  uint8_t count = trace_count;
+  SERIAL_PROTOCOLPGM("TRACE:");
+  SERIAL_PROTOCOL((int)count);
+  SERIAL_PROTOCOLPGM(" ");
+  SERIAL_PROTOCOLLN(6);
+  trace_event_t event;
+  while (count-- && trace_take(event))
+  {
+    // field by field, the simulator pads the struct
+    for (uint8_t i = 0; i < 4; ++i)
+      MYSERIAL.write(uint8_t(event.time >> (i * 8)));
+    MYSERIAL.write(event.type);
+    MYSERIAL.write(event.arg);
+  }
+  SERIAL_PROTOCOLLN("");
+}
+
+#endif
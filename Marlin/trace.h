@@ -0,0 +1,37 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include "Configuration.h"
+
+#ifdef EVENT_TRACE
+
+// the buffer index wraps with a mask, and the uint8_t event count has to hold a full buffer
+#if TRACE_BUFFER_SIZE < 1 || TRACE_BUFFER_SIZE > 128 || (TRACE_BUFFER_SIZE & (TRACE_BUFFER_SIZE - 1))
+  #error TRACE_BUFFER_SIZE must be a power of 2 up to 128
+#endif
+
+// event types, the argument is given per type
+#define TRACE_BLOCK_START  1    // stepper ISR took a block, arg: block buffer index
+#define TRACE_BLOCK_END    2    // stepper ISR finished a block, arg: block buffer index
+#define TRACE_PLAN_BUFFER  3    // plan_buffer_line() queued a block, arg: blocks in the planner
+#define TRACE_SD_READ      4    // start of a SD block read for the printed file, arg: 0
+#define TRACE_SD_READ_END  5
+#define TRACE_HEATER       8    // heater PWM changed, type + heater (EXTRUDERS is the bed), arg: PWM value
+
+// One event, dumped as is (little endian) by M48.
+struct trace_event_t {
+  uint32_t time;        // micros()
+  uint8_t type;
+  uint8_t arg;
+};
+
+// Record an event, safe to call from interrupts. Older events are overwritten when the buffer is full.
+void trace_event(uint8_t type, uint8_t arg);
+// Take the oldest event out of the buffer, false when it is empty.
+bool trace_take(trace_event_t &event);
+// M48: "TRACE:<count> <event size>", the events oldest first as binary and a line end. The buffer is emptied.
+void trace_dump();
+
+#endif
+#endif //TRACE_H
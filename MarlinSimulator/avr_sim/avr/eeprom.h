@@ -87,10 +87,13 @@ static inline void eeprom_write_block (const void *__src, void *__dst, size_t __
     memcpy(&__eeprom__storage[int(__dst)], __src, __n);
 }
 
-static inline void eeprom_update_byte (uint8_t *__p, uint8_t __value) {}
-static inline void eeprom_update_word (uint16_t *__p, uint16_t __value) {}
-static inline void eeprom_update_dword (uint32_t *__p, uint32_t __value) {}
-static inline void eeprom_update_float (float *__p, float __value) {}
-static inline void eeprom_update_block (const void *__src, void *__dst, size_t __n) {}
+static inline void eeprom_update_byte (uint8_t *__p, uint8_t __value) { eeprom_write_byte(__p, __value); }
+static inline void eeprom_update_word (uint16_t *__p, uint16_t __value) { eeprom_write_word(__p, __value); }
+static inline void eeprom_update_dword (uint32_t *__p, uint32_t __value) { eeprom_write_dword(__p, __value); }
+static inline void eeprom_update_float (float *__p, float __value) { eeprom_write_float_(__p, __value); }
+static inline void eeprom_update_block (const void *__src, void *__dst, size_t __n) { eeprom_write_block(__src, __dst, __n); }
+
+//Writes complete immediately in the simulation
+#define eeprom_is_ready() 1
 
 #endif	/* !_AVR_EEPROM_H_ */
@@ -17,6 +17,7 @@ typedef char prog_char;
 #define strncmp_P strncmp
 #define strncpy_P strncpy
 #define strchr_P strchr
+#define memcpy_P memcpy
 
 static inline uint8_t pgm_read_byte(const void* ptr)
 {
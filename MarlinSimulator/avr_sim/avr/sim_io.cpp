@@ -19,6 +19,9 @@ extern void TWI_vect();
 extern void TIMER0_OVF_vect();
 extern void TIMER0_COMPB_vect();
 extern void TIMER1_COMPA_vect();
+//Pin change interrupts are optional in the firmware
+extern void PCINT0_vect() __attribute__((weak));
+extern void PCINT2_vect() __attribute__((weak));
 
 unsigned int prevTicks = SDL_GetTicks();
 unsigned int twiIntStart = 0;
@@ -31,6 +34,19 @@ void sim_check_interrupts()
     if (!(SREG & _BV(SREG_I)))
         return;
 
+    //Pin change interrupts fire as soon as interrupts are enabled, the flag is cleared when the vector is executed
+    uint8_t pinChange = PCIFR & PCICR;
+    if (pinChange)
+    {
+        cli();
+        PCIFR.forceValue(PCIFR & ~pinChange);
+        if ((pinChange & _BV(PCIF0)) && PCINT0_vect)
+            PCINT0_vect();
+        if ((pinChange & _BV(PCIF2)) && PCINT2_vect)
+            PCINT2_vect();
+        _sei();
+    }
+
     unsigned int ticks = SDL_GetTicks();
     int tickDiff = ticks - prevTicks;
     prevTicks = ticks;
@@ -126,6 +126,21 @@ bool readOutput(int arduinoPinNr)
     return (*out) & bit;
 }
 
+//Flag a pin change interrupt, same PCINT pins as the ATmega2560 Arduino mapping: 10-13, 50-53 (PCINT0) and 62-69 (PCINT2)
+static void checkPinChangeInterrupt(int arduinoPinNr)
+{
+    if ((arduinoPinNr >= 10 && arduinoPinNr <= 13) || (arduinoPinNr >= 50 && arduinoPinNr <= 53))
+    {
+        if (PCMSK0 & _BV(digitalPinToPCMSKbit(arduinoPinNr)))
+            PCIFR |= _BV(PCIF0);
+    }
+    else if (arduinoPinNr >= 62 && arduinoPinNr <= 69)
+    {
+        if (PCMSK2 & _BV(digitalPinToPCMSKbit(arduinoPinNr)))
+            PCIFR |= _BV(PCIF2);
+    }
+}
+
 void writeInput(int arduinoPinNr, bool value)
 {
 	uint8_t bit = digitalPinToBitMask(arduinoPinNr);
@@ -134,8 +149,11 @@ void writeInput(int arduinoPinNr, bool value)
 	if (port == NOT_A_PIN) return;
 
 	AVRRegistor* in = portInputRegister(port);
+	bool oldValue = (*in) & bit;
 	if (value)
         (*in) |= bit;
     else
         (*in) &=~bit;
+    if (oldValue != value)
+        checkPinChangeInterrupt(arduinoPinNr);
 }
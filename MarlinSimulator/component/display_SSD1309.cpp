@@ -6,6 +6,11 @@ displaySDD1309Sim::displaySDD1309Sim(i2cSim* i2c, int id)
 {
     i2c->registerDevice(id, DELEGATE(i2cMessageDelegate, displaySDD1309Sim, *this, processMessage));
     lcd_data_pos = 0;
+    lcd_data_bytes = 0;
+    lcd_column_start = 0;
+    lcd_column_end = 127;
+    lcd_page_start = 0;
+    lcd_page_end = 7;
 }
 
 displaySDD1309Sim::~displaySDD1309Sim()
@@ -17,10 +22,21 @@ void displaySDD1309Sim::processMessage(uint8_t* message, int length)
     if (message[1] == 0x40)
     {
         //Data
+        lcd_data_bytes += length - 2;
         for(int n=2;n<length;n++)
         {
             lcd_data[lcd_data_pos] = message[n];
-            lcd_data_pos = (lcd_data_pos + 1) % 1024;
+            //Advance within the window, at its right edge continue at the start of the next page
+            int column = lcd_data_pos % 128;
+            int page = lcd_data_pos / 128;
+            if (column < lcd_column_end)
+            {
+                column++;
+            }else{
+                column = lcd_column_start;
+                page = (page < lcd_page_end) ? page + 1 : lcd_page_start;
+            }
+            lcd_data_pos = column + page * 128;
         }
     }else if (message[1] == 0x00)
     {
@@ -37,6 +53,14 @@ void displaySDD1309Sim::processMessage(uint8_t* message, int length)
             {
                 lcd_data_pos = (lcd_data_pos & 0x07F) | ((message[n] & 0x0F) << 7);
             }else if (message[n] == 0x20) { /*LCD_COMMAND_SET_ADDRESSING_MODE*/
+            }else if (message[n] == 0x21 && n + 2 < length) { /*LCD_COMMAND_SET_COLUMN_ADDRESS*/
+                lcd_column_start = message[++n] & 0x7F;
+                lcd_column_end = message[++n] & 0x7F;
+                lcd_data_pos = (lcd_data_pos & 0x380) | lcd_column_start;
+            }else if (message[n] == 0x22 && n + 2 < length) { /*LCD_COMMAND_SET_PAGE_ADDRESS*/
+                lcd_page_start = message[++n] & 0x07;
+                lcd_page_end = message[++n] & 0x07;
+                lcd_data_pos = (lcd_data_pos & 0x07F) | (lcd_page_start << 7);
             }else if (message[n] == 0x40) { /*Set start line*/
             }else if (message[n] == 0x81) { /*LCD_COMMAND_CONTRAST*/ n++;
             }else if (message[n] == 0xA1) { /*Segment remap*/
@@ -10,10 +10,19 @@ public:
     virtual ~displaySDD1309Sim();
     
     virtual void draw(int x, int y);
+
+    //What the display shows, 8 rows of 128 bytes with one bit per pixel like the firmware's lcd_buffer
+    const uint8_t* getData() const { return lcd_data; }
+    //Number of display data bytes received, the bus time the firmware spends on the screen
+    unsigned long getDataBytes() const { return lcd_data_bytes; }
 private:
     void processMessage(uint8_t* message, int length);
 
     int lcd_data_pos;
+    unsigned long lcd_data_bytes;
+    //Column and page window of the horizontal addressing mode
+    int lcd_column_start, lcd_column_end;
+    int lcd_page_start, lcd_page_end;
     uint8_t lcd_data[1024];
 };
 
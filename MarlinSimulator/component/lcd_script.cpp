@@ -0,0 +1,238 @@
+#include <string.h>
+#include <SDL/SDL.h>
+#include <avr/io.h>
+
+#include "lcd_script.h"
+#include "arduinoIO.h"
+
+extern int8_t lcd_lib_encoder_pos_interrupt;
+
+#define LCD_WIDTH 128
+#define LCD_HEIGHT 64
+#define BUTTON_PRESS_TIME 100
+//Frames that have to be sent after a check command, the first one can have been drawn before the last input
+#define CHECK_FRAMES 2
+#define CHECK_TIMEOUT 5000
+
+lcdScriptSim::lcdScriptSim(displaySDD1309Sim* display, int buttonPin, const char* scriptFilename, const char* goldenPath, bool updateGolden)
+: display(display), buttonPin(buttonPin), goldenPath(goldenPath), updateGolden(updateGolden), lineNr(0), waitUntil(0), releaseAt(0), checkFrames(0)
+, busy(false), frameEnd(0), frameBytes(0), frames(0), frameTime(0), frameTimeMax(0), bytes(0), checks(0), failures(0)
+{
+    checkName[0] = '\0';
+    script = fopen(scriptFilename, "r");
+    if (!script)
+    {
+        printf("LCD script %s could not be opened\n", scriptFilename);
+        exit(1);
+    }
+    writeInput(buttonPin, true);
+}
+
+lcdScriptSim::~lcdScriptSim()
+{
+    if (script)
+        fclose(script);
+}
+
+void lcdScriptSim::tick()
+{
+    unsigned long now = SDL_GetTicks();
+
+    //A frame is sent with TWI interrupts, the firmware disables them when it is complete
+    bool sending = (TWCR & _BV(TWEN)) && (TWCR & _BV(TWIE));
+    if (busy && !sending)
+    {
+        if (frameEnd)
+        {
+            frameTime += now - frameEnd;
+            if (now - frameEnd > frameTimeMax)
+                frameTimeMax = now - frameEnd;
+        }
+        frameEnd = now;
+        bytes += display->getDataBytes() - frameBytes;
+        frameBytes = display->getDataBytes();
+        frames++;
+        checkFrames++;
+    }
+    busy = sending;
+
+    if (releaseAt && now >= releaseAt)
+    {
+        writeInput(buttonPin, true);
+        releaseAt = 0;
+    }
+
+    if (checkName[0])
+    {
+        if (checkFrames >= CHECK_FRAMES && !busy)
+            check();
+        else if (now >= waitUntil)
+        {
+            printf("%s: no frames sent\n", checkName);
+            failures++;
+            checkName[0] = '\0';
+        }
+        return;
+    }
+    while (!checkName[0] && !releaseAt && now >= waitUntil && script)
+        nextCommand();
+}
+
+void lcdScriptSim::nextCommand()
+{
+    char line[128];
+    if (!fgets(line, sizeof(line), script))
+    {
+        fclose(script);
+        script = NULL;
+        printf("%i checks, %i failed\n", checks, failures);
+        exit(failures ? 1 : 0);
+    }
+    lineNr++;
+    char* comment = strchr(line, '#');
+    if (comment)
+        *comment = '\0';
+
+    char command[16];
+    char argument[64];
+    int count = sscanf(line, "%15s %63s", command, argument);
+    if (count < 1)
+        return;
+
+    unsigned long now = SDL_GetTicks();
+    if (strcmp(command, "wait") == 0 && count == 2)
+    {
+        waitUntil = now + atoi(argument);
+    }else if (strcmp(command, "turn") == 0 && count == 2)
+    {
+        lcd_lib_encoder_pos_interrupt += atoi(argument);
+    }else if (strcmp(command, "press") == 0)
+    {
+        writeInput(buttonPin, false);
+        releaseAt = now + BUTTON_PRESS_TIME;
+    }else if (strcmp(command, "check") == 0 && count == 2)
+    {
+        strcpy(checkName, argument);
+        checkFrames = 0;
+        waitUntil = now + CHECK_TIMEOUT;
+    }else{
+        printf("LCD script line %i: unknown command %s", lineNr, line);
+        exit(1);
+    }
+}
+
+void lcdScriptSim::check()
+{
+    uint8_t golden[LCD_WIDTH * LCD_HEIGHT / 8];
+    const uint8_t* data = display->getData();
+    char filename[256];
+    checks++;
+
+    printf("%s: ", checkName);
+    sprintf(filename, "%s/%s.pbm", goldenPath, checkName);
+    FILE* f = fopen(filename, "r");
+    if (f)
+        fclose(f);
+    //Only a missing golden image is stored, one that can't be read is not silently replaced
+    if (updateGolden || !f)
+    {
+        writeImage(filename, data);
+        printf("stored");
+    }
+    else if (!readImage(filename, golden))
+    {
+        failures++;
+        printf("FAILED, golden image unreadable");
+        sprintf(filename, "%s/%s.new.pbm", goldenPath, checkName);
+        writeImage(filename, data);
+    }
+    else
+    {
+        uint8_t diff[LCD_WIDTH * LCD_HEIGHT / 8];
+        int pixels = 0;
+        for(int n=0; n<LCD_WIDTH * LCD_HEIGHT / 8; n++)
+        {
+            diff[n] = golden[n] ^ data[n];
+            for(uint8_t bits = diff[n]; bits; bits &= bits - 1)
+                pixels++;
+        }
+        if (pixels)
+        {
+            failures++;
+            printf("FAILED, %i pixels differ", pixels);
+            sprintf(filename, "%s/%s.new.pbm", goldenPath, checkName);
+            writeImage(filename, data);
+            sprintf(filename, "%s/%s.diff.pbm", goldenPath, checkName);
+            writeImage(filename, diff);
+        }
+        else
+        {
+            printf("ok");
+        }
+    }
+    if (frames)
+        printf(", %i frames, %lu bytes/frame, %lu ms between frames (max %lu)\n", frames, bytes / frames, frameTime / frames, frameTimeMax);
+    else
+        printf("\n");
+
+    frames = 0;
+    frameTime = 0;
+    frameTimeMax = 0;
+    bytes = 0;
+    checkName[0] = '\0';
+    waitUntil = 0;
+}
+
+//Plain PBM, so the golden images can be viewed and diffed as text
+bool lcdScriptSim::readImage(const char* filename, uint8_t* data)
+{
+    FILE* f = fopen(filename, "r");
+    if (!f)
+        return false;
+    int width = 0, height = 0;
+    if (fscanf(f, "P1 %i %i", &width, &height) != 2 || width != LCD_WIDTH || height != LCD_HEIGHT)
+    {
+        fclose(f);
+        return false;
+    }
+    memset(data, 0, LCD_WIDTH * LCD_HEIGHT / 8);
+    for(int y=0; y<LCD_HEIGHT; y++)
+    {
+        for(int x=0; x<LCD_WIDTH; x++)
+        {
+            int c;
+            do { c = fgetc(f); } while (c == ' ' || c == '\n' || c == '\r' || c == '\t');
+            if (c == '1')
+                data[x + (y / 8) * LCD_WIDTH] |= _BV(y % 8);
+            else if (c != '0')
+            {
+                fclose(f);
+                return false;
+            }
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+void lcdScriptSim::writeImage(const char* filename, const uint8_t* data)
+{
+    FILE* f = fopen(filename, "w");
+    if (!f)
+    {
+        printf("%s could not be written\n", filename);
+        return;
+    }
+    fprintf(f, "P1\n%i %i\n", LCD_WIDTH, LCD_HEIGHT);
+    for(int y=0; y<LCD_HEIGHT; y++)
+    {
+        for(int x=0; x<LCD_WIDTH; x++)
+        {
+            fputc((data[x + (y / 8) * LCD_WIDTH] & _BV(y % 8)) ? '1' : '0', f);
+            //Plain PBM lines should not be longer than 70 characters
+            if (x % 64 == 63)
+                fputc('\n', f);
+        }
+    }
+    fclose(f);
+}
@@ -0,0 +1,54 @@
+#ifndef LCD_SCRIPT_SIM_H
+#define LCD_SCRIPT_SIM_H
+
+#include <stdio.h>
+
+#include "display_SSD1309.h"
+
+//Drives the encoder and button from a script and compares the display with stored golden images, so menu changes
+//can be checked without a printer. One command per line, # starts a comment:
+//  wait <ms>       let the firmware run
+//  turn <steps>    turn the encoder, negative steps turn it back
+//  press           press and release the button
+//  check <name>    wait for the screen to settle and compare it with <golden path>/<name>.pbm
+//A missing golden image is created from the display, one that can't be read fails the check. On a difference
+//<name>.new.pbm and <name>.diff.pbm are written next to it. For each check the frames sent since the previous one are reported with the display bytes and the time
+//between frames. When the script ends the simulator exits, with exit code 1 when a check failed.
+class lcdScriptSim : public simBaseComponent
+{
+public:
+    lcdScriptSim(displaySDD1309Sim* display, int buttonPin, const char* scriptFilename, const char* goldenPath, bool updateGolden=false);
+    virtual ~lcdScriptSim();
+
+    virtual void tick();
+private:
+    displaySDD1309Sim* display;
+    int buttonPin;
+    FILE* script;
+    const char* goldenPath;
+    bool updateGolden;
+    int lineNr;
+
+    unsigned long waitUntil;    //no new command before this time
+    unsigned long releaseAt;    //button release time, 0 when not pressed
+    char checkName[64];         //check waiting for the screen to settle
+    int checkFrames;
+
+    bool busy;                  //a frame is being sent to the display
+    unsigned long frameEnd;
+    unsigned long frameBytes;
+    int frames;                 //frames since the last check
+    unsigned long frameTime;    //sum of the time between these frames, in ms
+    unsigned long frameTimeMax;
+    unsigned long bytes;        //display data bytes sent for these frames
+
+    int checks;
+    int failures;
+
+    void nextCommand();
+    void check();
+    bool readImage(const char* filename, uint8_t* data);
+    void writeImage(const char* filename, const uint8_t* data);
+};
+
+#endif//LCD_SCRIPT_SIM_H
@@ -182,9 +182,21 @@ void sdcardSimulation::read_sd_block(int nr)
     sd_buffer[513] = crc;
 }
 
+//Random transfer errors, errorRate is the chance at F_CPU/2 and errors get rarer with slower SPI clocks.
+bool sdcardSimulation::transferError()
+{
+    static const int spiDivider[4] = {4, 16, 64, 128};
+    if (!errorRate)
+        return false;
+    int divider = spiDivider[SPCR & 0x03];
+    if (SPSR & _BV(SPI2X))
+        divider /= 2;
+    return (rand() % (errorRate * divider / 2)) == 0;
+}
+
 void sdcardSimulation::ISP_SPDR_callback(uint8_t oldValue, uint8_t& newValue)
 {
-    if (errorRate && (rand() % errorRate) == 0)
+    if (transferError())
         newValue = rand();
     if ((PING & _BV(2)))
     {
@@ -262,7 +274,7 @@ void sdcardSimulation::ISP_SPDR_callback(uint8_t oldValue, uint8_t& newValue)
         break;
     }
     //Introduce random errors in SD communication
-    if (errorRate && (rand() % errorRate) == 0)
+    if (transferError())
         newValue = rand();
 
     //Mark transfer finished
@@ -13,6 +13,7 @@ public:
     
     void ISP_SPDR_callback(uint8_t oldValue, uint8_t& newValue);
     void read_sd_block(int nr);
+    bool transferError();
 
     int sd_state;
     uint8_t sd_buffer[1024];
@@ -0,0 +1,330 @@
+#include <string.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include <avr/io.h>
+
+#include "sdcard_image.h"
+#include "../../Marlin/SdInfo.h"
+
+static uint16_t CRC_CCITT(const uint8_t* data, size_t n)
+{
+    uint16_t crc = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        crc ^= data[i] << 8;
+        for (uint8_t b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+    return crc;
+}
+
+sdcardImageSim::sdcardImageSim(const char* imageFilename, int readLatency, int writeLatency, int errorRate, const char* traceFilename)
+: image(NULL), imageBlocks(0), trace(NULL), readLatency(readLatency), writeLatency(writeLatency), errorRate(errorRate), random(1)
+, state(IDLE), cmdPos(0), appCmd(false), multiple(false), block(0), blockCount(0), data(NULL), dataLeft(0), corruptPos(-1)
+, writePos(0), responsePos(0), byteCount(0), commandStart(0)
+{
+#ifdef _WIN32
+    fileHandle = CreateFileA(imageFilename, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    mapHandle = NULL;
+    if (fileHandle != INVALID_HANDLE_VALUE)
+    {
+        DWORD size = GetFileSize(fileHandle, NULL);
+        mapHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READWRITE, 0, 0, NULL);
+        if (mapHandle)
+            image = (uint8_t*)MapViewOfFile(mapHandle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+        if (image)
+            imageBlocks = size / 512;
+    }
+#else
+    fd = open(imageFilename, O_RDWR);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0)
+    {
+        void* map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED)
+        {
+            image = (uint8_t*)map;
+            imageBlocks = st.st_size / 512;
+        }
+    }
+#endif
+    if (!image)
+        printf("SD image %s could not be mapped, card stays empty\n", imageFilename);
+    if (traceFilename)
+        trace = fopen(traceFilename, "w");
+
+    SPDR.setCallback(DELEGATE(registerDelegate, sdcardImageSim, *this, ISP_SPDR_callback));
+}
+
+sdcardImageSim::~sdcardImageSim()
+{
+    if (trace)
+        fclose(trace);
+#ifdef _WIN32
+    if (image)
+        UnmapViewOfFile(image);
+    if (mapHandle)
+        CloseHandle(mapHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE)
+        CloseHandle(fileHandle);
+#else
+    if (image)
+        munmap(image, imageBlocks * 512);
+    if (fd >= 0)
+        close(fd);
+#endif
+}
+
+//Deterministic pseudo random errors, so a run with the same image and settings always fails the same blocks.
+bool sdcardImageSim::injectError()
+{
+    if (!errorRate)
+        return false;
+    random = random * 1103515245 + 12345;
+    return ((random >> 16) % errorRate) == 0;
+}
+
+void sdcardImageSim::traceCommand(const char* name)
+{
+    if (trace)
+        fprintf(trace, "%10lu %s%d %08x\n", byteCount, name, cmd[0] & 0x3F, (cmd[1] << 24) | (cmd[2] << 16) | (cmd[3] << 8) | cmd[4]);
+}
+
+void sdcardImageSim::queueReadBlock()
+{
+    if (block >= imageBlocks)
+    {
+        response.push_back(0x08);//Data error token: out of range
+        endTransfer();
+        return;
+    }
+    //At least one byte of access time, so the host sees the card not busy between blocks
+    for (int n = 0; n < readLatency || n < 1; n++)
+        response.push_back(0xFF);
+    response.push_back(DATA_START_BLOCK);
+    data = image + block * 512;
+    dataLeft = 512;
+    corruptPos = injectError() ? (random >> 16) % 512 : -1;
+    block++;
+}
+
+void sdcardImageSim::endWriteBlock()
+{
+    if (block >= imageBlocks || injectError())
+    {
+        response.push_back(0x0B);//Data rejected due to a CRC error
+        if (trace)
+            fprintf(trace, "%10lu   write %08x rejected\n", byteCount, block);
+    }
+    else
+    {
+        memcpy(image + block * 512, writeBuffer, 512);
+        block++;
+        blockCount++;
+        response.push_back(DATA_RES_ACCEPTED);
+        for (int n = 0; n < writeLatency; n++)
+            response.push_back(0x00);//Busy programming
+    }
+    if (multiple)
+        state = WRITE_TOKEN;
+    else
+        endTransfer();
+}
+
+void sdcardImageSim::endTransfer()
+{
+    if (trace && blockCount)
+        fprintf(trace, "%10lu   %u blocks in %lu bytes\n", byteCount, blockCount, byteCount - commandStart);
+    state = IDLE;
+    blockCount = 0;
+    dataLeft = 0;
+}
+
+void sdcardImageSim::command()
+{
+    uint8_t nr = cmd[0] & 0x3F;
+    uint32_t arg = (cmd[1] << 24) | (cmd[2] << 16) | (cmd[3] << 8) | cmd[4];
+    bool acmd = appCmd;
+    appCmd = false;
+
+    //Any command ends a read in progress, this is how CMD12 stops a multiple block read
+    if (state != IDLE)
+        endTransfer();
+    response.clear();
+    responsePos = 0;
+    commandStart = byteCount;
+    traceCommand(acmd ? "ACMD" : "CMD");
+
+    if (acmd)
+    {
+        switch(nr)
+        {
+        case ACMD23://Pre-erase count, nothing to do for an image
+        case ACMD41:
+            response.push_back(R1_READY_STATE);
+            return;
+        }
+    }
+    switch(nr)
+    {
+    case CMD0:
+        response.push_back(R1_IDLE_STATE);
+        break;
+    case CMD8://SD2 card, echo the check pattern
+        response.push_back(R1_IDLE_STATE);
+        response.push_back(0x00);
+        response.push_back(0x00);
+        response.push_back(cmd[3]);
+        response.push_back(cmd[4]);
+        break;
+    case CMD9:{//Version 2 CSD with the image size
+        uint32_t cSize = imageBlocks / 1024 - 1;
+        uint8_t csd[16] = {0x40, 0x0E, 0x00, 0x32, 0x5B, 0x59, 0x00, uint8_t((cSize >> 16) & 0x3F), uint8_t(cSize >> 8), uint8_t(cSize), 0x7F, 0x80, 0x0A, 0x40, 0x00, 0x01};
+        uint16_t crc = CRC_CCITT(csd, 16);
+        response.push_back(R1_READY_STATE);
+        response.push_back(0xFF);
+        response.push_back(DATA_START_BLOCK);
+        response.insert(response.end(), csd, csd + 16);
+        response.push_back(crc >> 8);
+        response.push_back(crc);
+        }break;
+    case CMD12://Stuff byte, then R1
+        response.push_back(0xFF);
+        response.push_back(R1_READY_STATE);
+        break;
+    case CMD13://R2
+        response.push_back(R1_READY_STATE);
+        response.push_back(0x00);
+        break;
+    case CMD17:
+    case CMD18:
+    case CMD24:
+    case CMD25:
+        if (!image || arg >= imageBlocks)
+        {
+            response.push_back(0x20);//R1 address error
+            break;
+        }
+        response.push_back(R1_READY_STATE);
+        block = arg;
+        multiple = (nr == CMD18 || nr == CMD25);
+        if (nr == CMD17 || nr == CMD18)
+        {
+            state = READ;
+            queueReadBlock();
+        }
+        else
+        {
+            state = WRITE_TOKEN;
+        }
+        break;
+    case CMD32:
+    case CMD33:
+    case CMD38://Erase, the data may stay like on most cards
+        response.push_back(R1_READY_STATE);
+        break;
+    case CMD55:
+        appCmd = true;
+        response.push_back(R1_READY_STATE);
+        break;
+    case CMD58://OCR with CCS set, so the image is block addressed like SDHC
+        response.push_back(R1_READY_STATE);
+        response.push_back(0xC0);
+        response.push_back(0xFF);
+        response.push_back(0x80);
+        response.push_back(0x00);
+        break;
+    default:
+        printf("SD image CMD: %02x %02x %02x %02x %02x %02x\n", nr, cmd[1], cmd[2], cmd[3], cmd[4], cmd[5]);
+        response.push_back(R1_ILLEGAL_COMMAND);
+        break;
+    }
+}
+
+void sdcardImageSim::ISP_SPDR_callback(uint8_t oldValue, uint8_t& newValue)
+{
+    uint8_t in = newValue;
+    byteCount++;
+    if ((PING & _BV(2)) || !image)
+    {
+        //No card inserted, return 0xFF
+        newValue = 0xFF;
+        SPSR |= _BV(SPIF);//Mark transfer finished
+        return;
+    }
+
+    if (state == WRITE_DATA)
+    {
+        //512 data bytes and 2 CRC bytes, the CRC is not checked like in SPI mode
+        writeBuffer[writePos++] = in;
+        if (writePos == (int)sizeof(writeBuffer))
+            endWriteBlock();
+        newValue = 0xFF;
+    }
+    else if (cmdPos > 0 || (in & 0xC0) == 0x40)
+    {
+        cmd[cmdPos++] = in;
+        if (cmdPos == 6) // 1 cmd, 4 param, 1 crc
+        {
+            cmdPos = 0;
+            command();
+        }
+        newValue = 0xFF;
+    }
+    else if (state == WRITE_TOKEN && in != 0xFF)
+    {
+        if (in == DATA_START_BLOCK || in == WRITE_MULTIPLE_TOKEN)
+        {
+            state = WRITE_DATA;
+            writePos = 0;
+        }
+        else if (in == STOP_TRAN_TOKEN)
+        {
+            endTransfer();
+            for (int n = 0; n < writeLatency; n++)
+                response.push_back(0x00);//Busy
+        }
+        newValue = 0xFF;
+    }
+    else if (responsePos < response.size())
+    {
+        newValue = response[responsePos++];
+        if (responsePos == response.size())
+        {
+            response.clear();
+            responsePos = 0;
+        }
+    }
+    else if (state == READ && dataLeft > 0)
+    {
+        newValue = *data++;
+        if (512 - dataLeft == corruptPos)
+            newValue ^= 0x5A;
+        if (--dataLeft == 0)
+        {
+            blockCount++;
+            uint16_t crc = CRC_CCITT(data - 512, 512);
+            response.push_back(crc >> 8);
+            response.push_back(crc);
+            if (corruptPos >= 0 && trace)
+                fprintf(trace, "%10lu   read %08x corrupted\n", byteCount, block - 1);
+            if (multiple)
+                queueReadBlock();
+            else
+                endTransfer();
+        }
+    }
+    else
+    {
+        newValue = 0xFF;
+    }
+
+    //Mark transfer finished
+    SPSR |= _BV(SPIF);
+}
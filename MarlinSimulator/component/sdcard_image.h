@@ -0,0 +1,64 @@
+#ifndef SDCARD_IMAGE_SIM_H
+#define SDCARD_IMAGE_SIM_H
+
+#include <stdio.h>
+
+#include "base.h"
+
+//SD card backed by a raw FAT16/FAT32 disk image (for example a dd copy of a real card), mapped into memory.
+//Blocks are served straight from the mapping, so fragmented files and multiple block transfers behave like
+//they do on the real card. Latencies are counted in SPI bytes, so runs are deterministic.
+class sdcardImageSim : public simBaseComponent
+{
+public:
+    sdcardImageSim(const char* imageFilename, int readLatency=0, int writeLatency=0, int errorRate=0, const char* traceFilename=NULL);
+    virtual ~sdcardImageSim();
+
+    void ISP_SPDR_callback(uint8_t oldValue, uint8_t& newValue);
+
+    //Number of SPI bytes transferred, the time base for the trace and the latencies.
+    unsigned long getByteCount() const { return byteCount; }
+private:
+    enum State { IDLE, READ, WRITE_TOKEN, WRITE_DATA };
+
+    uint8_t* image;
+    uint32_t imageBlocks;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mapHandle;
+#else
+    int fd;
+#endif
+    FILE* trace;
+
+    int readLatency;    //0xFF bytes before each read data token
+    int writeLatency;   //busy bytes after each accepted write block
+    int errorRate;      //1 in errorRate blocks is corrupted on read or rejected on write, 0 for none
+    uint32_t random;
+
+    State state;
+    uint8_t cmd[6];
+    int cmdPos;
+    bool appCmd;
+    bool multiple;
+    uint32_t block;         //block being read or written
+    uint32_t blockCount;    //blocks transferred by the current command
+    const uint8_t* data;    //remaining read data, served straight from the image
+    int dataLeft;
+    int corruptPos;         //index of the read byte to corrupt, -1 for none
+    uint8_t writeBuffer[512 + 2];
+    int writePos;
+    std::vector<uint8_t> response;  //bytes to send before any data
+    unsigned int responsePos;
+    unsigned long byteCount;
+    unsigned long commandStart;
+
+    void command();
+    void queueReadBlock();
+    void endWriteBlock();
+    void endTransfer();
+    bool injectError();
+    void traceCommand(const char* name);
+};
+
+#endif//SDCARD_IMAGE_SIM_H
@@ -8,6 +8,7 @@ stepperSim::stepperSim(arduinoIOSim* arduinoIO, int enablePinNr, int stepPinNr,
     this->stepValue = 0;
     this->minEndstopPin = -1;
     this->maxEndstopPin = -1;
+    this->endstopOverrun = 0;
 
     this->invertDir = invertDir;
     this->enablePin = enablePinNr;
@@ -33,9 +34,19 @@ void stepperSim::stepPinUpdate(int pinNr, bool high)
     if (minStepValue == -1)
         return;
     if (stepValue < minStepValue)
+    {
         stepValue = minStepValue;
-    if (stepValue > maxStepValue)
+        endstopOverrun++;
+    }
+    else if (stepValue > maxStepValue)
+    {
         stepValue = maxStepValue;
+        endstopOverrun++;
+    }
+    else if (stepValue != minStepValue && stepValue != maxStepValue)
+    {
+        endstopOverrun = 0;
+    }
     if (minEndstopPin > -1)
         writeInput(minEndstopPin, stepValue != minStepValue);
     if (maxEndstopPin > -1)
@@ -54,6 +65,9 @@ void stepperSim::setEndstops(int minEndstopPinNr, int maxEndstopPinNr)
 void stepperSim::draw(int x, int y)
 {
     char buffer[32] = {0};
-    sprintf(buffer, "%i steps", int(stepValue));
+    if (endstopOverrun)
+        sprintf(buffer, "%i steps (+%i)", int(stepValue), endstopOverrun);
+    else
+        sprintf(buffer, "%i steps", int(stepValue));
     drawString(x, y, buffer, 0xFFFFFF);
 }
@@ -13,6 +13,7 @@ private:
     bool invertDir;
     int enablePin, stepPin, dirPin;
     int minEndstopPin, maxEndstopPin;
+    int endstopOverrun;//Steps received while the endstop was already pressed, shows how fast the firmware reacts to the endstop.
 public:
     stepperSim(arduinoIOSim* arduinoIO, int enablePinNr, int stepPinNr, int dirPinNr, bool invertDir);
     virtual ~stepperSim();
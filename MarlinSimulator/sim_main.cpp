@@ -5,11 +5,13 @@
 #include <avr/io.h>
 
 #include "component/sdcard.h"
+#include "component/sdcard_image.h"
 #include "component/adc.h"
 #include "component/heater.h"
 #include "component/serial.h"
 #include "component/display_SSD1309.h"
 #include "component/display_HD44780.h"
+#include "component/lcd_script.h"
 #include "component/led_PCA9632.h"
 #include "component/arduinoIO.h"
 #include "component/stepper.h"
@@ -18,8 +20,10 @@
 #include "../Marlin/UltiLCD2.h"
 #include "../Marlin/temperature.h"
 #include "../Marlin/stepper.h"
+#include "../Marlin/trace.h"
 
 SDL_Surface *screen;
+bool headless;
 
 extern int8_t lcd_lib_encoder_pos_interrupt;
 extern int8_t encoderDiff;
@@ -30,14 +34,16 @@ int stoppedValue;
 
 void setupGui()
 {
-    if ( SDL_Init(SDL_INIT_VIDEO) < 0 )
+    headless = getenv("SIM_LCD_SCRIPT") != NULL;
+    if ( SDL_Init(headless ? SDL_INIT_TIMER : SDL_INIT_VIDEO) < 0 )
     {
         fprintf(stderr, "Unable to init SDL: %s\n", SDL_GetError());
         exit(1);
     }
     atexit(SDL_Quit);
 
-    screen = SDL_SetVideoMode(1024, 600, 32, SDL_SWSURFACE);
+    if (!headless)
+        screen = SDL_SetVideoMode(1024, 600, 32, SDL_SWSURFACE);
 }
 
 unsigned long lastUpdate = SDL_GetTicks();
@@ -53,6 +59,14 @@ void guiUpdate()
         return;
     lastUpdate = SDL_GetTicks();
 
+    if (headless)
+    {
+        //The script drives the encoder and button
+        writeInput(SDCARDDETECT, !cardInserted);
+        writeInput(SAFETY_TRIGGERED_PIN, stoppedValue);
+        return;
+    }
+
     int clickX = -1, clickY = -1;
     SDL_Event event;
     while (SDL_PollEvent(&event))
@@ -212,6 +226,35 @@ public:
     }
 };
 
+#ifdef EVENT_TRACE
+static const char* eventTraceFile;
+
+//Writes the events left in the trace buffer in the same format as M48, so decodeTrace.py reads both.
+static void writeEventTrace()
+{
+    std::vector<trace_event_t> events;
+    trace_event_t event;
+    while(trace_take(event))
+        events.push_back(event);
+
+    FILE* f = fopen(eventTraceFile, "wb");
+    if (!f)
+    {
+        fprintf(stderr, "Cannot write event trace %s\n", eventTraceFile);
+        return;
+    }
+    fprintf(f, "TRACE:%u 6\n", (unsigned int)events.size());
+    for(unsigned int n=0; n<events.size(); n++)
+    {
+        for(int i=0; i<4; i++)
+            fputc((events[n].time >> (i * 8)) & 0xFF, f);
+        fputc(events[n].type, f);
+        fputc(events[n].arg, f);
+    }
+    fputc('\n', f);
+    fclose(f);
+}
+#endif
 
 void sim_setup_main()
 {
@@ -238,12 +281,30 @@ void sim_setup_main()
     (new heaterSim(HEATER_0_PIN, adc, TEMP_0_PIN))->setDrawPosition(130, 70);
     (new heaterSim(HEATER_1_PIN, adc, TEMP_1_PIN))->setDrawPosition(130, 80);
     (new heaterSim(HEATER_BED_PIN, adc, TEMP_BED_PIN, 0.2))->setDrawPosition(130, 90);
-    new sdcardSimulation("c:/models/", 5000);
+    //SIM_SD_IMAGE=card.img uses a raw FAT image instead of the fake FAT view of c:/models/, with optional
+    //SIM_SD_READ_LATENCY, SIM_SD_WRITE_LATENCY (in SPI bytes), SIM_SD_ERROR_RATE (1 in N blocks) and SIM_SD_TRACE (file).
+    if (getenv("SIM_SD_IMAGE"))
+        new sdcardImageSim(getenv("SIM_SD_IMAGE"), atoi(getenv("SIM_SD_READ_LATENCY") ?: "0"), atoi(getenv("SIM_SD_WRITE_LATENCY") ?: "0"),
+            atoi(getenv("SIM_SD_ERROR_RATE") ?: "0"), getenv("SIM_SD_TRACE"));
+    else
+        new sdcardSimulation("c:/models/", 5000);
     (new serialSim())->setDrawPosition(150, 0);
+#ifdef EVENT_TRACE
+    //SIM_EVENT_TRACE=trace.bin writes the event trace buffer to that file on exit.
+    eventTraceFile = getenv("SIM_EVENT_TRACE");
+    if (eventTraceFile)
+        atexit(writeEventTrace);
+#endif
 #if defined(ULTIBOARD_V2_CONTROLLER) || defined(ENABLE_ULTILCD2)
     i2cSim* i2c = new i2cSim();
-    (new displaySDD1309Sim(i2c))->setDrawPosition(0, 0);
+    displaySDD1309Sim* display = new displaySDD1309Sim(i2c);
+    display->setDrawPosition(0, 0);
     (new ledPCA9632Sim(i2c))->setDrawPosition(1, 66);
+    //SIM_LCD_SCRIPT=menus.txt runs without a window and checks the screens against the golden images in SIM_LCD_GOLDEN
+    //(default the working directory), SIM_LCD_UPDATE=1 replaces them. See component/lcd_script.h for the commands,
+    //test/menus for the scripts of the main, print, maintenance and tinkergnome menus ("make menus" in test).
+    if (headless)
+        new lcdScriptSim(display, BTN_ENC, getenv("SIM_LCD_SCRIPT"), getenv("SIM_LCD_GOLDEN") ?: ".", getenv("SIM_LCD_UPDATE") != NULL);
 #endif
 #if defined(ULTIPANEL) && !defined(ULTIBOARD_V2_CONTROLLER)
     (new displayHD44780Sim(arduinoIO, LCD_PINS_RS, LCD_PINS_ENABLE, LCD_PINS_D4, LCD_PINS_D5,LCD_PINS_D6,LCD_PINS_D7))->setDrawPosition(0, 0);
@@ -0,0 +1,110 @@
+#!/usr/bin/python
+"""FAT16/FAT32 image check, like fsck.fat -n
+
+Usage: python fatcheck.py card.img
+
+Checks that both FAT copies are equal, that every file's cluster chain is
+valid, not shared with another file and as long as the file size needs,
+and reports allocated clusters that no file uses (lost clusters).
+Exits with 1 when a problem is found.
+"""
+from __future__ import print_function
+import struct
+import sys
+
+def main(argv):
+    if len(argv) != 1:
+        print(__doc__)
+        sys.exit(2)
+    img = open(argv[0], "rb").read()
+    if struct.unpack_from("<H", img, 0x1FE)[0] != 0xAA55:
+        fail("no boot sector")
+    start = 0
+    # partitioned card: use the first partition
+    if img[0x1BE] in (0x00, 0x80) and img[0x1C2] != 0 and not img[0:3] in (b"\xeb\x3c\x90", b"\xeb\x58\x90"):
+        start = struct.unpack_from("<I", img, 0x1C6)[0] * 512
+    bps, spc, reserved, nfats, rootents, total16, _, fatsz16 = struct.unpack_from("<HBHBHHBH", img, start + 11)
+    total = total16 or struct.unpack_from("<I", img, start + 32)[0]
+    fatsz = fatsz16 or struct.unpack_from("<I", img, start + 36)[0]
+    rootsecs = (rootents * 32 + bps - 1) // bps
+    datastart = reserved + nfats * fatsz + rootsecs
+    nclusters = (total - datastart) // spc
+    fat32 = nclusters >= 65525
+    eoc = 0x0FFFFFF8 if fat32 else 0xFFF8
+    fatoff = start + reserved * bps
+    fats = [img[fatoff + n * fatsz * bps:fatoff + (n + 1) * fatsz * bps] for n in range(nfats)]
+    problems = []
+    for n in range(1, nfats):
+        if fats[n] != fats[0]:
+            problems.append("FAT copy %d differs from the first" % (n))
+
+    def get(c):
+        if fat32:
+            return struct.unpack_from("<I", fats[0], c * 4)[0] & 0x0FFFFFFF
+        return struct.unpack_from("<H", fats[0], c * 2)[0]
+
+    def clusterOffset(c):
+        return start + (datastart + (c - 2) * spc) * bps
+
+    owner = {}
+    def chain(first, name):
+        result = []
+        c = first
+        while c < eoc:
+            if c < 2 or c >= nclusters + 2:
+                problems.append("%s: bad cluster %d in chain" % (name, c))
+                break
+            if c in owner:
+                problems.append("%s: cluster %d is also used by %s" % (name, c, owner[c]))
+                break
+            owner[c] = name
+            result.append(c)
+            c = get(c)
+        return result
+
+    files = []
+    def walk(entries, path):
+        for n in range(0, len(entries), 32):
+            e = entries[n:n + 32]
+            if e[0] == 0:
+                break
+            if e[0] == 0xE5 or e[11] == 0x0F or e[11] & 0x08:
+                continue
+            name = e[0:8].decode("latin-1").rstrip()
+            ext = e[8:11].decode("latin-1").rstrip()
+            full = path + name + ("." + ext if ext else "")
+            if name in (".", ".."):
+                continue
+            first = struct.unpack_from("<H", e, 26)[0] | (struct.unpack_from("<H", e, 20)[0] << 16 if fat32 else 0)
+            size = struct.unpack_from("<I", e, 28)[0]
+            clusters = chain(first, full) if first else []
+            if e[11] & 0x10:
+                walk(b"".join(img[clusterOffset(c):clusterOffset(c) + spc * bps] for c in clusters), full + "/")
+                continue
+            need = (size + spc * bps - 1) // (spc * bps)
+            if len(clusters) != need:
+                problems.append("%s: %d bytes need %d clusters, the chain has %d" % (full, size, need, len(clusters)))
+            files.append((full, size, len(clusters)))
+
+    if fat32:
+        walk(b"".join(img[clusterOffset(c):clusterOffset(c) + spc * bps] for c in chain(struct.unpack_from("<I", img, start + 44)[0], "/")), "/")
+    else:
+        rootoff = start + (reserved + nfats * fatsz) * bps
+        walk(img[rootoff:rootoff + rootents * 32], "/")
+
+    lost = [c for c in range(2, nclusters + 2) if get(c) != 0 and c not in owner and get(c) != (0x0FFFFFF7 if fat32 else 0xFFF7)]
+    if lost:
+        problems.append("%d lost clusters" % (len(lost)))
+    for full, size, count in files:
+        print("%-24s %10d bytes %6d clusters" % (full, size, count))
+    for p in problems:
+        print(p)
+    print("%d files, %d of %d clusters used, %s" % (len(files), len(owner), nclusters, "%d problems" % len(problems) if problems else "OK"))
+    sys.exit(1 if problems else 0)
+
+def fail(msg):
+    print(msg)
+    sys.exit(1)
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
@@ -0,0 +1,10 @@
+;FLAVOR:UltiGCode
+;TIME:600
+;MATERIAL:1000
+;MATERIAL2:0
+;NOZZLE_DIAMETER:0.4
+G28
+G1 Z5 F3000
+G1 X50 Y50 F3000
+G1 Z0.3
+G1 X100 E5 F1200
@@ -0,0 +1,6 @@
+;FLAVOR:RepRap
+;TIME:600
+G28
+G1 X50 Y50 Z10 F6000
+; stays printing with a fixed position, so the print screens do not change
+G4 S600
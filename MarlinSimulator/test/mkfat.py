@@ -0,0 +1,76 @@
+#!/usr/bin/python3
+"""FAT16 SD card image
+
+Writes an empty superfloppy FAT16 image (no partition table, 4 KiB clusters)
+with optional files in the root directory, for SIM_SD_IMAGE.
+
+Usage: python3 mkfat.py image size_mb [NAME.EXT=hostfile ...]
+
+The names are 8.3 without long file names. size_mb should be 17 or more,
+FAT16 needs at least 4085 clusters.
+"""
+
+from __future__ import print_function
+import sys
+import struct
+
+SECTOR = 512
+SECTORS_PER_CLUSTER = 8
+RESERVED = 1
+FATS = 2
+ROOT_ENTRIES = 512
+
+def main(argv):
+    if len(argv) < 2:
+        print(__doc__)
+        sys.exit(2)
+    out, mb = argv[0], int(argv[1])
+    total = mb * 2048
+    rootSectors = ROOT_ENTRIES * 32 // SECTOR
+    fatSize = (total // SECTORS_PER_CLUSTER * 2 + SECTOR - 1) // SECTOR + 1
+    dataStart = RESERVED + FATS * fatSize + rootSectors
+    clusters = (total - dataStart) // SECTORS_PER_CLUSTER
+    if clusters < 4085 or len(argv) - 2 > ROOT_ENTRIES:
+        print("%d MB is too small for FAT16" % (mb), file=sys.stderr)
+        sys.exit(1)
+
+    img = bytearray(total * SECTOR)
+    img[0:11] = b"\xeb\x3c\x90MSWIN4.1"
+    struct.pack_into("<HBHBHHBHHHII", img, 11, SECTOR, SECTORS_PER_CLUSTER, RESERVED, FATS, ROOT_ENTRIES,
+        total if total <= 0xFFFF else 0, 0xF8, fatSize, 32, 64, 0, total if total > 0xFFFF else 0)
+    struct.pack_into("<BBBI11s8s", img, 36, 0x80, 0, 0x29, 0x12345678, b"SIMCARD    ", b"FAT16   ")
+    img[510:512] = b"\x55\xaa"
+
+    def setFat(cluster, value):
+        for f in range(FATS):
+            struct.pack_into("<H", img, (RESERVED + f * fatSize) * SECTOR + cluster * 2, value)
+    setFat(0, 0xFFF8)
+    setFat(1, 0xFFFF)
+
+    rootOffset = (RESERVED + FATS * fatSize) * SECTOR
+    cluster = 2
+    for index, arg in enumerate(argv[2:]):
+        name, path = arg.split("=", 1)
+        base, ext = (name.upper().split(".") + [""])[:2]
+        with open(path, "rb") as f:
+            data = f.read()
+        count = (len(data) + SECTORS_PER_CLUSTER * SECTOR - 1) // (SECTORS_PER_CLUSTER * SECTOR)
+        if cluster + count > clusters + 2:
+            print("%s does not fit" % (name), file=sys.stderr)
+            sys.exit(1)
+
+        entry = rootOffset + index * 32
+        img[entry:entry + 11] = (base.ljust(8) + ext.ljust(3)).encode()
+        img[entry + 11] = 0x20
+        struct.pack_into("<HI", img, entry + 26, cluster if count else 0, len(data))
+        offset = (dataStart + (cluster - 2) * SECTORS_PER_CLUSTER) * SECTOR
+        img[offset:offset + len(data)] = data
+        for c in range(cluster, cluster + count):
+            setFat(c, c + 1 if c < cluster + count - 1 else 0xFFFF)
+        cluster += count
+
+    with open(out, "wb") as f:
+        f.write(img)
+
+if __name__ == "__main__":
+    main(sys.argv[1:])
@@ -0,0 +1,60 @@
+// Host test of the stepper timer tables in speed_lookuptable.h, see Makefile.
+// Build once per F_CPU and SPEED_LOOKUP_FAST_SHIFT; compares speed_lookup_timer() (calc_timer() of the stepper ISR)
+// with the exact interval F_CPU/8/rate for every step rate up to MAX_STEP_FREQUENCY.
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "speed_lookuptable.h"
+
+// Allowed error of the interval. Linear interpolation of 1/rate is worst at the low end of the slow table
+// (8 steps/s per entry). In the fast table the interval is down to 200 counts, the rounded entries and the
+// interpolation between them stay within one count there, 0.5%.
+#define MAX_ERROR_SLOW_PERCENT 1.3
+#define MAX_ERROR_FAST_PERCENT 0.5
+
+static int failed = 0;
+static double worst_slow = 0, worst_fast = 0;
+
+static void check(uint16_t rate)
+{
+  uint8_t loops = 0;
+  uint16_t timer = speed_lookup_timer(rate, loops);
+
+  uint16_t limited = rate > MAX_STEP_FREQUENCY ? MAX_STEP_FREQUENCY : rate;
+  uint16_t expected_loops = limited > 20000 ? 4 : (limited > 10000 ? 2 : 1);
+  double interrupt_rate = double(limited) / expected_loops;
+  if (interrupt_rate < F_CPU / 500000)
+    interrupt_rate = F_CPU / 500000;
+  double exact = double(F_CPU / 8) / interrupt_rate;
+  double error = (timer - exact) / exact * 100.0;
+  bool fast = interrupt_rate - F_CPU / 500000 >= 8 * 256;
+  double &worst = fast ? worst_fast : worst_slow;
+  if (fabs(error) > fabs(worst))
+    worst = error;
+
+  if (loops != expected_loops || fabs(error) > (fast ? MAX_ERROR_FAST_PERCENT : MAX_ERROR_SLOW_PERCENT))
+  {
+    if (++failed <= 10)
+      printf("FAIL rate %u: timer %u loops %u, expected %.1f loops %u (%.2f%%)\n", rate, timer, loops, exact, expected_loops, error);
+  }
+}
+
+int main()
+{
+  // the last fast entry that is used also needs the entry after it for the difference
+  uint16_t last_index = ((SPEED_LOOKUP_MAX_RATE - F_CPU / 500000) >> SPEED_LOOKUP_FAST_SHIFT) + 1;
+  if (last_index >= SPEED_LOOKUP_FAST_SIZE)
+  {
+    printf("FAIL fast table has %d entries, %u are used\n", SPEED_LOOKUP_FAST_SIZE, last_index + 1);
+    ++failed;
+  }
+
+  for (uint32_t rate = 1; rate <= MAX_STEP_FREQUENCY; ++rate)
+    check(rate);
+  // rates above the maximum are limited to it
+  check(0xFFFF);
+
+  printf("F_CPU %lu, SPEED_LOOKUP_FAST_SHIFT %d: fast table %d entries, worst error slow %.2f%% fast %.2f%%, %s\n",
+    (unsigned long)F_CPU, SPEED_LOOKUP_FAST_SHIFT, SPEED_LOOKUP_FAST_SIZE, worst_slow, worst_fast, failed ? "FAILED" : "OK");
+  return failed ? 1 : 0;
+}